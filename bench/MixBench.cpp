@@ -0,0 +1,244 @@
+#include "LoopLauncher.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// MixBench
+// Measures what mixing costs, using synthetic in-memory clips so
+// there's no file I/O or audio device involved. Results go to stdout
+// as CSV, one row per configuration, so they can be diffed and
+// tracked over time:
+//
+//   bench,isa,channels,block,tracks,ns_per_sample,ns_per_track_sample,x_realtime,checksum
+//
+// ns_per_sample is per output sample (frames * channels); the track
+// version divides that by the track count. The checksum is a hash of
+// everything rendered, which should match across instruction sets.
+// With --compressed every onGetData row is followed by one with the
+// clips losslessly compressed (see CompressedClipBuffer), so the
+// difference is what decoding costs; its checksum should match.
+//
+// Usage: MixBench [--quick] [--all-isa] [--compressed]
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	// Lets us call onGetData ourselves, so it can be timed
+	// on its own rather than through an output sink
+	struct BenchLauncher : public LoopLauncher
+	{
+		bool GetData( OutputSink::Chunk& chunk )
+		{
+			return onGetData( chunk );
+		}
+	};
+
+	const int s_nSampleRate = 44100;
+	const int s_nClipFrames = s_nSampleRate / 2;
+
+	// A decaying tone, different for every track and clip
+	Clip makeClip( int nTrack, int nClip, int nChannels )
+	{
+		std::vector<sf::Int16> vSamples( s_nClipFrames * nChannels );
+		const double dFreq = 55. * (1 + (nTrack * 7 + nClip * 3) % 24);
+		for ( int i = 0; i < s_nClipFrames; i++ )
+		{
+			const double dEnv = std::exp( -3. * i / s_nClipFrames );
+			const sf::Int16 nSample = (sf::Int16) (8000. * dEnv * std::sin( 6.283185307179586 * dFreq * i / s_nSampleRate ));
+			for ( int c = 0; c < nChannels; c++ )
+				vSamples[i * nChannels + c] = nSample;
+		}
+
+		Clip clip;
+		clip.LoadFromSamples( vSamples.data(), s_nClipFrames, nChannels, s_nSampleRate );
+		return clip;
+	}
+
+	// 64 bit FNV-1a
+	void hashSamples( sf::Uint64& uHash, const sf::Int16 * pSamples, size_t nSamples )
+	{
+		const unsigned char * pBytes = (const unsigned char *) pSamples;
+		for ( size_t i = 0; i < nSamples * sizeof( sf::Int16 ); i++ )
+			uHash = (uHash ^ pBytes[i]) * 1099511628211ull;
+	}
+
+	struct Result
+	{
+		double dNsPerSample;
+		double dRealtime;
+		sf::Uint64 uChecksum;
+	};
+
+	// Time onGetData with nTracks tracks all playing, switching
+	// clips every loop so the crossfade path gets exercised too
+	Result benchOnGetData( int nChannels, int nBlockSize, int nTracks, int nTotalFrames, bool bCompressed )
+	{
+		BenchLauncher ll;
+		ll.SetClipCompression( bCompressed, 0 );
+		for ( int t = 0; t < nTracks; t++ )
+		{
+			std::map<std::string, Clip> mapClips;
+			for ( int c = 0; c < 2; c++ )
+				mapClips.emplace( "clip_" + std::to_string( t ) + "_" + std::to_string( c ), makeClip( t, c, nChannels ) );
+			ll.AddTrack( "track_" + std::to_string( t ), std::move( mapClips ) );
+		}
+		ll.Initialize( {}, nBlockSize );
+
+		auto fnQueueClips = [&ll, nTracks] ( int nClip )
+		{
+			std::list<int> liClips;
+			for ( int t = 0; t < nTracks; t++ )
+				liClips.push_back( LoopLauncher::MakeClipHandle( t, nClip ) );
+			ll.UpdatePendingClipHandles( liClips );
+		};
+
+		// Warm up for a bit, then time the rest
+		const int nWarmupBlocks = 16;
+		const int nBlocks = std::max( 1, nTotalFrames / nBlockSize );
+		sf::Uint64 uChecksum = 14695981039346656037ull;
+		Clock::duration dur( 0 );
+		int nClip = 0;
+		fnQueueClips( nClip );
+		for ( int b = 0; b < nWarmupBlocks + nBlocks; b++ )
+		{
+			if ( ll.NeedsAudio() )
+				fnQueueClips( nClip ^= 1 );
+
+			OutputSink::Chunk chunk;
+			const Clock::time_point tStart = Clock::now();
+			ll.GetData( chunk );
+			if ( b >= nWarmupBlocks )
+				dur += Clock::now() - tStart;
+
+			hashSamples( uChecksum, chunk.pSamples, chunk.nSamples );
+		}
+
+		const double dNs = (double) std::chrono::duration_cast<std::chrono::nanoseconds>( dur ).count();
+		const double dSamples = double( nBlocks ) * nBlockSize * nChannels;
+		const double dSeconds = double( nBlocks ) * nBlockSize / s_nSampleRate;
+
+		return { dNs / dSamples, dSeconds / (dNs * 1e-9), uChecksum };
+	}
+
+	// Time Track::GetAudio on its own, for one playing track
+	Result benchGetAudio( int nChannels, int nBlockSize, int nTotalFrames )
+	{
+		LoopLauncher::Track track;
+		VoicePool voices;
+		track.AddClip( "clip", makeClip( 0, 0, nChannels ) );
+		track.StageClip( 0 );
+		track.PostStagedClip();
+		track.Launch( voices, 0 );
+
+		PlanarBuffer<float> bus;
+		bus.Resize( nChannels, nBlockSize );
+		float * apBus[LoopLauncher::s_nMaxChannels];
+		for ( int c = 0; c < nChannels; c++ )
+			apBus[c] = bus.GetChannel( c );
+
+		const int nBlocks = std::max( 1, nTotalFrames / nBlockSize );
+		sf::Int64 nFrame = 0;
+
+		const Clock::time_point tStart = Clock::now();
+		for ( int b = 0; b < nBlocks; b++ )
+		{
+			track.GetAudio( apBus, nBlockSize, nFrame, voices );
+			nFrame += nBlockSize;
+		}
+		const Clock::duration dur = Clock::now() - tStart;
+
+		// Hash the bus (interleaved) so the work can't be optimized away
+		std::vector<float> vBus( nBlockSize * nChannels );
+		bus.Interleave( vBus.data(), 0, nBlockSize );
+		std::vector<sf::Int16> vOut( vBus.size() );
+		for ( size_t i = 0; i < vBus.size(); i++ )
+			vOut[i] = (sf::Int16) std::lrint( std::max( -1.f, std::min( 1.f, vBus[i] / nBlocks ) ) * 32767.f );
+		sf::Uint64 uChecksum = 14695981039346656037ull;
+		hashSamples( uChecksum, vOut.data(), vOut.size() );
+
+		const double dNs = (double) std::chrono::duration_cast<std::chrono::nanoseconds>( dur ).count();
+		const double dSamples = double( nBlocks ) * nBlockSize * nChannels;
+		const double dSeconds = double( nBlocks ) * nBlockSize / s_nSampleRate;
+
+		return { dNs / dSamples, dSeconds / (dNs * 1e-9), uChecksum };
+	}
+}
+
+int main( int argc, char ** argv )
+{
+	bool bQuick = false;
+	bool bAllISA = false;
+	bool bCompressed = false;
+	for ( int i = 1; i < argc; i++ )
+	{
+		if ( std::strcmp( argv[i], "--quick" ) == 0 )
+			bQuick = true;
+		else if ( std::strcmp( argv[i], "--all-isa" ) == 0 )
+			bAllISA = true;
+		else if ( std::strcmp( argv[i], "--compressed" ) == 0 )
+			bCompressed = true;
+		else
+		{
+			std::fprintf( stderr, "Usage: %s [--quick] [--all-isa] [--compressed]\n", argv[0] );
+			return 1;
+		}
+	}
+
+	std::vector<MixKernels::EISA> vISAs = { MixKernels::GetBestISA() };
+	if ( bAllISA )
+	{
+		vISAs.clear();
+		for ( int i = 0; i <= (int) MixKernels::GetBestISA(); i++ )
+			vISAs.push_back( (MixKernels::EISA) i );
+	}
+
+	const std::vector<int> vChannels = { 1, 2 };
+	const std::vector<int> vBlockSizes = bQuick ? std::vector<int>{ 256 } : std::vector<int>{ 64, 128, 256, 512, 1024 };
+	const std::vector<int> vTrackCounts = bQuick ? std::vector<int>{ 1, 8, 64 } : std::vector<int>{ 1, 2, 4, 8, 16, 32, 64, 128, 256, 512 };
+
+	// Keep the amount of mixing per configuration roughly constant
+	const double dTrackFrameBudget = bQuick ? 4e6 : 2e7;
+
+	std::printf( "bench,isa,channels,block,tracks,ns_per_sample,ns_per_track_sample,x_realtime,checksum\n" );
+	for ( MixKernels::EISA eISA : vISAs )
+	{
+		MixKernels::SetISA( eISA );
+		const char * szISA = MixKernels::GetISAName( eISA );
+
+		for ( int nChannels : vChannels )
+		{
+			for ( int nBlockSize : vBlockSizes )
+			{
+				const int nFrames = (int) (dTrackFrameBudget / nChannels);
+				const Result res = benchGetAudio( nChannels, nBlockSize, nFrames );
+				std::printf( "GetAudio,%s,%d,%d,%d,%.4f,%.4f,%.1f,%016llx\n", szISA, nChannels, nBlockSize, 1,
+					res.dNsPerSample, res.dNsPerSample, res.dRealtime, (unsigned long long) res.uChecksum );
+
+				for ( int nTracks : vTrackCounts )
+				{
+					const int nTotalFrames = std::max( 4 * nBlockSize, (int) (dTrackFrameBudget / (nTracks * nChannels)) );
+					const Result res = benchOnGetData( nChannels, nBlockSize, nTracks, nTotalFrames, false );
+					std::printf( "onGetData,%s,%d,%d,%d,%.4f,%.4f,%.1f,%016llx\n", szISA, nChannels, nBlockSize, nTracks,
+						res.dNsPerSample, res.dNsPerSample / nTracks, res.dRealtime, (unsigned long long) res.uChecksum );
+
+					if ( bCompressed )
+					{
+						const Result resCompressed = benchOnGetData( nChannels, nBlockSize, nTracks, nTotalFrames, true );
+						std::printf( "onGetDataCompressed,%s,%d,%d,%d,%.4f,%.4f,%.1f,%016llx\n", szISA, nChannels, nBlockSize, nTracks,
+							resCompressed.dNsPerSample, resCompressed.dNsPerSample / nTracks, resCompressed.dRealtime, (unsigned long long) resCompressed.uChecksum );
+					}
+					std::fflush( stdout );
+				}
+			}
+		}
+	}
+
+	return 0;
+}
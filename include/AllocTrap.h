@@ -0,0 +1,35 @@
+#pragma once
+
+// AllocTrap
+// A debug aid for keeping the audio thread allocation free. Going
+// to the heap from the audio callback can take a lock or a page
+// fault, which is a dropout waiting to happen, and it's easy to
+// slip one in without noticing (a string temporary, a vector that
+// outgrows what was reserved.)
+//
+// When the engine is built with LL_ALLOC_TRAP (the CMake option
+// LOOPLAUNCHER_ALLOC_TRAP), the global operator new and delete are
+// replaced, along with malloc and friends where glibc lets us wrap
+// them, so that any allocation or free made by a thread inside a
+// Scope is trapped: by default we print what happened and abort,
+// so a render or a session with the option on fails loudly rather
+// than glitching. Without it a Scope does nothing at all.
+namespace AllocTrap
+{
+	// Mark the calling thread as the audio thread while this lives
+	class Scope
+	{
+	public:
+		Scope();
+		~Scope();
+		Scope( const Scope& ) = delete;
+		Scope& operator=( const Scope& ) = delete;
+	};
+
+	// Whether the trap was built in
+	bool IsEnabled();
+
+	// Abort on a trapped allocation (the default), or just count it
+	void SetAbort( bool bAbort );
+	int GetTrapCount();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+// BoundarySignal
+// Lets the control thread sleep until the audio thread reaches a
+// boundary of the launch grid, rather than polling NeedsAudio on
+// a timer. The audio thread bumps a counter at every boundary and
+// the control thread waits for it to change.
+//
+// Notifying never blocks or takes a lock: it's an atomic increment,
+// plus a wake syscall if (and only if) someone is waiting. On Linux
+// the wait is a futex on the counter, on Windows it's WaitOnAddress;
+// anywhere else the control thread checks the counter every
+// millisecond, which is still far cheaper than calling into Python.
+class BoundarySignal
+{
+public:
+	BoundarySignal();
+
+	BoundarySignal( const BoundarySignal& ) = delete;
+	BoundarySignal& operator=( const BoundarySignal& ) = delete;
+
+	// Called from the audio thread
+	void Notify();
+
+	// How many times Notify has been called
+	unsigned int GetCount() const;
+
+	// Called from the control thread, waits until the count isn't
+	// uCount any more or nTimeoutMS milliseconds have gone by (a
+	// negative timeout waits forever), and returns the count
+	unsigned int Wait( unsigned int uCount, int nTimeoutMS );
+
+private:
+	std::atomic<unsigned int> m_uCount;
+	std::atomic<int> m_nWaiters;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+// CallbackStats
+// What the audio callback has been up to, so that when we hear a
+// dropout there's something to look at. The audio thread is the only
+// writer and everything is a relaxed atomic, so recording never locks
+// or allocates; other threads can read at any time, and may see a
+// snapshot that's a callback out of date (which is fine for this.)
+class CallbackStats
+{
+public:
+	// CallbackStats::Histogram
+	// Fixed power of two buckets; bucket 0 counts zeros, bucket
+	// i counts values in [2^(i-1), 2^i), and the last one counts
+	// everything too big for the others
+	class Histogram
+	{
+	public:
+		static constexpr int s_nBucketCount = 24;
+
+		Histogram();
+		void Add( unsigned int uValue );
+		void Reset();
+
+		int GetCount() const;
+		unsigned int GetMax() const;
+		double GetMean() const;
+
+		// The upper edge of the bucket the percentile falls in,
+		// which overestimates by at most a factor of 2
+		double GetPercentile( double dPercentile ) const;
+		std::vector<int> GetBucketCounts() const;
+
+	private:
+		std::atomic<int> m_anBuckets[s_nBucketCount];
+		std::atomic<int> m_nCount;
+		std::atomic<unsigned long long> m_uSum;
+		std::atomic<unsigned int> m_uMax;
+	};
+
+	CallbackStats();
+
+	// Called from the audio thread; times are in microseconds except
+	// for boundary posts, which are cheap enough to need nanoseconds.
+	// The interval is 0 for the first callback after a restart
+	void RecordCallback( unsigned int uDurationUS, unsigned int uIntervalUS, int nFrames, float fBlockUS );
+	void RecordBoundaryPost( unsigned int uDurationNS );
+
+	// Called from anywhere
+	void Reset();
+
+	// Counters and percentiles by name (see the cpp for the keys)
+	std::map<std::string, double> GetSummary() const;
+
+	// Bucket counts for one of callback_us, interval_us,
+	// block_frames or boundary_ns; empty for anything else
+	std::vector<int> GetHistogram( std::string histogramName ) const;
+
+private:
+	Histogram m_hCallbackUS;
+	Histogram m_hIntervalUS;
+	Histogram m_hBlockFrames;
+	Histogram m_hBoundaryNS;
+
+	// Callbacks that took longer than the audio they produced lasts;
+	// a few of these in a row and SFML runs out of buffered audio
+	std::atomic<int> m_nLateCallbacks;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "ClipBuffer.h"
+#include "CompressedClipBuffer.h"
+
+#include <memory>
+#include <string>
+
+class ClipStream;
+
+// Clip
+// One audio file a track can play. Short clips are decoded into
+// a ClipBuffer up front, which is shared with every other clip
+// of the same file via the ClipCache; long ones (ambient stems, beds,
+// etc.) are streamed from disk by a ClipStream so we don't hold
+// hundreds of MB of PCM. Streams aren't shared, since each one
+// has its own read position. Either way the audio thread reads
+// them through GetSpan, which hands back contiguous runs of
+// samples for each channel.
+//
+// Decoded clips can also be compressed (see CompressedClipBuffer),
+// in which case GetSpan decodes the block under the cursor into a
+// few slots of our own and hands back spans from there, up to the
+// end of that block. The slots are reused least recently used
+// first, so a tail or one-shot voice reading the same clip as its
+// track doesn't make either of them decode every span.
+class Clip
+{
+public:
+	Clip();
+	Clip( Clip&& );
+	Clip& operator=( Clip&& );
+	~Clip();
+
+	// Decode or open the file for streaming, depending on how long it is
+	bool LoadFromFile( std::string fileName );
+
+	// Make a clip out of samples we already have (i.e. synthesized ones)
+	// These don't go through the clip cache
+	bool LoadFromSamples( const sf::Int16 * pSamples, int nFrames, int nChannels, int nSampleRate );
+
+	int GetChannelCount() const;
+	int GetSampleRate() const;
+	int GetFrameCount() const;
+	bool IsLoaded() const;
+	bool IsStreaming() const;
+	bool IsCompressed() const;
+
+	// Empty if we didn't come from a file
+	std::string GetFileName() const;
+
+	// Swap our PCM for a compressed copy of it (shared through the
+	// ClipCache if we came from a file), dropping nLossyBits low bits
+	// (see CompressedClipBuffer.) Streamed clips are decoded into
+	// memory first; conform before compressing, since conforming a
+	// compressed clip means decompressing it again. Clips that are
+	// already compressed are left as they are
+	bool Compress( int nLossyBits );
+
+	// Convert the clip to another sample rate and channel count, if
+	// it isn't already in them (see ClipConform.) Clips loaded from
+	// files get their converted audio from the ClipCache; streamed
+	// ones are decoded into memory, since streams can't be conformed
+	// on the fly without doing it on the I/O thread
+	bool Conform( int nSampleRate, int nChannels );
+
+	// Stretch the clip from one tempo to another, keeping its pitch
+	// (see ClipStretch.) Files go through the TempoCache, after which
+	// we play the stretched file it made; if that can't be done, or
+	// we didn't come from a file, it's done in memory. Do this before
+	// conforming, so the cache holds the file in its own format
+	bool ConformTempo( float fSrcBPM, float fDstBPM );
+
+	// How often a streamed clip has had to hand back silence
+	// because the disk couldn't keep up; always 0 if not streaming
+	int GetUnderrunCount() const;
+
+	// Called from the audio thread; nCursor is the frame we're at,
+	// which the caller wraps back to 0 when it reaches the end.
+	// Points ppChannels[c] at channel c (there must be room for
+	// GetChannelCount() of them) and returns how many frames can be
+	// read from each contiguously
+	int GetSpan( int nCursor, const sf::Int16 ** ppChannels );
+
+	// Called from the audio thread when the clip launches
+	void Restart();
+
+	// Files longer than this get streamed
+	static constexpr float s_fStreamSeconds = 20.f;
+
+	// How many decoded blocks a compressed clip keeps around
+	static constexpr int s_nDecodeSlots = 4;
+
+private:
+	bool conformPCM( int nSampleRate, int nChannels );
+
+	// Returns the slot holding nBlock, decoding it if need be
+	int getDecodeSlot( int nBlock );
+
+	std::shared_ptr<const ClipBuffer> m_pBuffer;
+	std::unique_ptr<ClipStream> m_pStream;
+	std::shared_ptr<const CompressedClipBuffer> m_pCompressed;
+
+	// Decoded blocks of a compressed clip, s_nDecodeSlots runs of
+	// CompressedClipBuffer::s_nBlockFrames frames; which block each
+	// slot holds (-1 for none) and when it was last read
+	PlanarBuffer<sf::Int16> m_DecodeSlots;
+	int m_anSlotBlock[s_nDecodeSlots];
+	unsigned int m_auSlotUse[s_nDecodeSlots];
+	unsigned int m_uSlotClock;
+
+	// Empty if we didn't come from a file
+	std::string m_strFileName;
+};
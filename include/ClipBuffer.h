@@ -0,0 +1,31 @@
+#pragma once
+
+#include "PlanarBuffer.h"
+
+#include <SFML/Config.hpp>
+
+#include <string>
+
+// ClipBuffer
+// A decoded clip: planar Int16 samples (see PlanarBuffer) and the
+// rate they were recorded at. SFML decodes interleaved audio, so it
+// gets split into channels as it's read.
+class ClipBuffer : public PlanarBuffer<sf::Int16>
+{
+public:
+	ClipBuffer();
+
+	// Decode a whole file
+	bool LoadFromFile( std::string fileName );
+
+	// Copy nFrames frames of interleaved samples
+	bool LoadFromSamples( const sf::Int16 * pSamples, int nFrames, int nChannels, int nSampleRate );
+
+	int GetSampleRate() const;
+	void SetSampleRate( int nSampleRate );
+
+	size_t GetByteCount() const;
+
+private:
+	int m_nSampleRate;
+};
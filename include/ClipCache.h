@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ClipBuffer.h"
+#include "CompressedClipBuffer.h"
+
+#include <memory>
+#include <string>
+
+// ClipCache
+// A process-wide cache of decoded clips, so a file that shows up in
+// several tracks (or several launchers) is only decoded and stored
+// once. Entries are keyed by canonical path and reference counted:
+// whoever acquires a clip holds a shared_ptr to its buffer, and the
+// entry goes away once the last one is released.
+//
+// Content hashing can be turned on to also catch identical audio
+// saved under different names; it costs a pass over every decoded
+// buffer, so it's off by default. All of this is thread safe, but
+// none of it is meant to be called from the audio thread.
+namespace ClipCache
+{
+	// Decode fileName, or share the buffer if it's already been
+	// decoded; returns null if the file couldn't be loaded
+	std::shared_ptr<const ClipBuffer> Acquire( std::string fileName );
+
+	// Same as above, but conformed to a sample rate and channel count
+	// (see ClipConform.) Conformed buffers are cached separately for
+	// each format, so tracks sharing a file share the conversion too
+	std::shared_ptr<const ClipBuffer> Acquire( std::string fileName, int nSampleRate, int nChannels );
+
+	// Same as above, but compressed with nLossyBits bits dropped (see
+	// CompressedClipBuffer.) The PCM it was compressed from isn't
+	// kept, so unless something else holds on to that it's freed
+	// once this returns
+	std::shared_ptr<const CompressedClipBuffer> AcquireCompressed( std::string fileName, int nSampleRate, int nChannels, int nLossyBits );
+
+	// The path a file name resolves to, or the name itself if
+	// it can't be resolved (i.e. it doesn't exist)
+	std::string GetCanonicalPath( std::string fileName );
+
+	void SetContentHashing( bool bContentHashing );
+	bool GetContentHashing();
+
+	// How many buffers are live and how many bytes of samples they
+	// hold, compressed ones included
+	int GetEntryCount();
+	size_t GetByteCount();
+}
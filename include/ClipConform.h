@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ClipBuffer.h"
+
+// ClipConform
+// Converts clips to the stream's sample rate and channel count when
+// they're loaded, so the mixer never sees a clip in another format.
+// Rates are converted with a windowed sinc polyphase resampler whose
+// inner loop is MixKernels::DotProduct, and channels are mixed down
+// (averaged) to mono or copied up from mono. Clips are loops, so the
+// resampler wraps around the ends of the clip instead of padding them
+// with silence, and the result lasts as long as the source did (to
+// the nearest frame.) This is slow next to decoding, so it's meant
+// to be run on the ClipLoader pool.
+namespace ClipConform
+{
+	// Conform src into dst, replacing whatever was there
+	bool Conform( const ClipBuffer& src, ClipBuffer& dst, int nSampleRate, int nChannels );
+}
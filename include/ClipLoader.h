@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Clip.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// ClipLoader
+// A pool of worker threads for the slow part of starting up, which is
+// decoding (and otherwise preparing) clips. The pool lives as long as
+// a ParallelFor call; jobs are handed out one at a time, so long files
+// don't hold up short ones. Nothing here touches Python, so callers
+// coming from Python should release the GIL first.
+namespace ClipLoader
+{
+	// Run fnJob( 0 ) ... fnJob( nJobs - 1 ) across the pool,
+	// returning once they've all finished. The calling thread
+	// does its share of the work too
+	void ParallelFor( int nJobs, std::function<void( int )> fnJob );
+
+	// Load every file; vClips[i] is loaded from vFileNames[i] if that
+	// worked (see Clip::IsLoaded), and the names of the files that
+	// didn't are appended to vFailures
+	std::vector<Clip> LoadClips( const std::vector<std::string>& vFileNames, std::vector<std::string>& vFailures );
+
+	// Defaults to the number of hardware threads
+	int GetThreadCount();
+	void SetThreadCount( int nThreads );
+}
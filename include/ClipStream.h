@@ -0,0 +1,98 @@
+#pragma once
+
+#include "PlanarBuffer.h"
+
+#include <SFML/Audio/InputSoundFile.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+// ClipStream
+// A clip that's too long to keep decoded in memory. The first
+// second or so (the head) is decoded when the stream is opened and
+// stays resident, so the loop start is always ready when the clip
+// launches. The rest (the tail) is decoded on a background I/O
+// thread into a ring buffer, looping back to the end of the head
+// when it hits the end of the file. The head and ring are planar;
+// the file decodes interleaved, so each chunk is split into channels
+// on the I/O thread before it's published.
+//
+// The audio thread only ever reads PCM that the I/O thread has
+// published; if the ring runs dry it gets silence (an underrun)
+// rather than waiting. Each launch restarts the stream, which bumps
+// an epoch so the I/O thread knows to seek back and refill the ring.
+// Only one read position is supported, which is fine because a track
+// never plays the same clip at two positions at once.
+class ClipStream
+{
+public:
+	ClipStream();
+	~ClipStream();
+
+	// These get registered with the I/O thread, so they can't move
+	ClipStream( const ClipStream& ) = delete;
+	ClipStream& operator=( const ClipStream& ) = delete;
+
+	// Open the file, decode the head and start streaming the tail
+	bool Open( std::string fileName );
+
+	int GetChannelCount() const;
+	int GetSampleRate() const;
+	int GetFrameCount() const;
+
+	// How many times the audio thread came up empty
+	int GetUnderrunCount() const;
+
+	// Called from the audio thread; nCursor is the frame we're at,
+	// and only ever moves forward until it wraps back to the start
+	// (or the clip is restarted.) Points ppChannels[c] at channel c
+	// and returns how many frames can be read from each contiguously
+	int GetSpan( int nCursor, const sf::Int16 ** ppChannels );
+
+	// Called from the audio thread when the clip launches
+	void Restart();
+
+	// Called from the I/O thread, decodes a chunk if there's room
+	// in the ring; returns false if there was nothing to do
+	bool Service();
+
+	static constexpr float s_fHeadSeconds = 1.f;
+	static constexpr float s_fRingSeconds = 4.f;
+	static constexpr int s_nDecodeChunkFrames = 4096;
+	static constexpr int s_nSilenceFrames = 1024;
+
+private:
+	// The read and write positions are frame counts into the tail,
+	// packed with the epoch they belong to so each side can tell a
+	// restart happened with a single atomic load
+	static constexpr int s_nEpochShift = 48;
+	static constexpr sf::Uint64 s_uTailMask = (sf::Uint64( 1 ) << s_nEpochShift) - 1;
+	static sf::Uint64 packState( unsigned uEpoch, sf::Int64 nTail );
+
+	sf::InputSoundFile m_File;
+	int m_nChannels;
+	int m_nSampleRate;
+	int m_nFrames;
+	int m_nHeadFrames;
+	int m_nRingFrames;
+	PlanarBuffer<sf::Int16> m_Head;
+	PlanarBuffer<sf::Int16> m_Ring;
+	PlanarBuffer<sf::Int16> m_Silence;
+
+	// Written by the audio thread
+	// The loop tail is where the tail starts on this pass through
+	// the clip, in the same (never wrapping) count as the read tail
+	unsigned m_uEpoch;
+	sf::Int64 m_nLoopTail;
+	sf::Int64 m_nReadTail;
+	std::atomic<sf::Uint64> m_uReadState;
+	std::atomic<int> m_nUnderruns;
+
+	// Written by the I/O thread
+	unsigned m_uDecodeEpoch;
+	sf::Int64 m_nDecodeTail;
+	int m_nFilePos;
+	std::vector<sf::Int16> m_vDecode;
+	std::atomic<sf::Uint64> m_uWriteState;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "ClipBuffer.h"
+
+#include <string>
+
+// ClipStretch
+// Changes how long a clip lasts without changing its pitch, so loops
+// recorded at other tempos can play in time with the project (see
+// LoopLauncher::SetProjectTempo.) It's WSOLA: the output is built out
+// of overlapping Hann windowed grains of the source, each taken from
+// about where it would land if we were resampling, but nudged so its
+// waveform lines up with the grain before it; that's how the pitch
+// survives. The search is done on a mono mix with MixKernels::DotProduct
+// and every channel uses the same grains, so the stereo image holds.
+//
+// Clips are loops, so grains wrap around the ends of the source and
+// the output, and the loop point stays seamless. Like ClipConform this
+// is slow, so it's meant to be run on the ClipLoader pool, and results
+// are usually kept on disk (see TempoCache.)
+namespace ClipStretch
+{
+	// Stretch src to nDstFrames frames, replacing whatever was in dst
+	bool Stretch( const ClipBuffer& src, ClipBuffer& dst, int nDstFrames );
+
+	// The tempo a clip was recorded at. If the file's name says (i.e.
+	// "beat_96bpm.wav") we believe it; otherwise we take it to last a
+	// whole number of bars (or a half, quarter or eighth of one) and
+	// go with whichever is closest to fBPM
+	float GetSourceTempo( std::string fileName, int nFrames, int nSampleRate, float fBPM, int nBeatsPerBar );
+
+	// How long a clip nFrames long at fSrcBPM lasts at fDstBPM
+	int GetStretchedFrameCount( int nFrames, float fSrcBPM, float fDstBPM );
+
+	// Tempos closer than this (as a fraction) aren't worth stretching
+	static constexpr float s_fTempoTolerance = 0.001f;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "ClipBuffer.h"
+
+#include <SFML/Config.hpp>
+
+#include <vector>
+
+// CompressedClipBuffer
+// A clip held in memory compressed (losslessly, or nearly) for sets
+// whose PCM won't fit in RAM but that we'd rather not stream from
+// disk. The audio is cut into fixed size blocks that can each be decoded on
+// their own, so the audio thread only decodes the block it's about
+// to play (see Clip::GetSpan.)
+//
+// Each channel of a block is predicted with whichever fixed
+// polynomial predictor (order 0, 1 or 2) leaves the smallest
+// residuals, and the residuals are bit packed in groups of
+// s_nGroupFrames with a width per group. That's not as tight as an
+// entropy coder, but decoding a block is a fixed amount of branch
+// free work no matter what the audio is, which is what the audio
+// thread needs.
+//
+// Losslessly, dense mixes come out at around 60% of their PCM size
+// and loops with any space in them a good deal smaller. For more
+// than that, low bits can be given up: each one dropped saves about
+// a bit per sample, at the cost of noise 6 dB louder (two bits is
+// still 14 bit quality, and usually around half the size.)
+class CompressedClipBuffer
+{
+public:
+	static constexpr int s_nBlockFrames = 1024;
+	static constexpr int s_nGroupFrames = 32;
+	static constexpr int s_nMaxLossyBits = 8;
+
+	CompressedClipBuffer();
+
+	// Compress a decoded clip, dropping nLossyBits low bits of
+	// precision (0 for lossless, up to s_nMaxLossyBits)
+	bool Encode( const ClipBuffer& buffer, int nLossyBits );
+
+	// Decompress the whole thing (not for the audio thread)
+	bool Decode( ClipBuffer& buffer ) const;
+
+	// Called from the audio thread; decodes block nBlock into buffer
+	// starting at nFrame, which needs room for s_nBlockFrames frames
+	// and as many channels as we have, and returns how many frames
+	// the block holds. Doesn't allocate
+	int DecodeBlock( int nBlock, PlanarBuffer<sf::Int16>& buffer, int nFrame ) const;
+
+	int GetChannelCount() const;
+	int GetSampleRate() const;
+	int GetFrameCount() const;
+	int GetLossyBits() const;
+	int GetBlockCount() const;
+	int GetBlockFrameCount( int nBlock ) const;
+
+	size_t GetByteCount() const;
+
+private:
+	int m_nChannels;
+	int m_nSampleRate;
+	int m_nFrames;
+	int m_nLossyBits;
+
+	// Where each block's channels start in m_vData,
+	// indexed by nBlock * m_nChannels + nChannel
+	std::vector<size_t> m_vOffsets;
+	std::vector<unsigned char> m_vData;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// EpochReclaimer
+// Frees things the audio thread may still be reading, once it can't
+// be. The control thread never changes what the audio thread reads
+// in place; it publishes a new version through an atomic pointer
+// and retires the old one here, and the audio thread picks up
+// whatever's been published at the start of each block.
+//
+// The audio thread brackets every block with Enter and Exit, which
+// bump an epoch counter, so the epoch is odd while it's mixing and
+// even while it isn't. If the epoch was even when something was
+// retired, the audio thread wasn't holding it and will find the new
+// version next time; if it was odd, it might be, but won't once the
+// block it's in is over and the epoch moves on. Neither side ever
+// waits on the other, and the audio thread never frees anything.
+class EpochReclaimer
+{
+public:
+	EpochReclaimer();
+	~EpochReclaimer();
+
+	EpochReclaimer( const EpochReclaimer& ) = delete;
+	EpochReclaimer& operator=( const EpochReclaimer& ) = delete;
+
+	// Called from the audio thread around every block
+	void Enter();
+	void Exit();
+
+	// Called from the control thread, after publishing whatever
+	// replaces pRetired; it's freed by a later Reclaim call
+	void Retire( std::shared_ptr<const void> pRetired );
+
+	// Called from the control thread, frees what's safe to free
+	// and returns how many things are still waiting
+	int Reclaim();
+
+	// Free everything; only safe once the audio thread is stopped
+	void Clear();
+
+private:
+	struct Retired
+	{
+		std::shared_ptr<const void> pObject;
+		unsigned int uEpoch;
+	};
+
+	std::atomic<unsigned int> m_uEpoch;
+	std::vector<Retired> m_vRetired;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+// FadeCurves
+// Gain curves for crossfading one clip into another. The curves
+// are sampled from tables generated at compile time, so nothing
+// here calls into libm; t goes from 0 (start of the fade) to 1.
+// The incoming clip is scaled by FadeGain( t ), the outgoing one
+// by FadeGain( 1 - t ), which for equal power means sin and cos.
+namespace FadeCurves
+{
+	enum class EShape
+	{
+		Linear,		// Gains sum to 1; dips in level for uncorrelated audio
+		EqualPower	// Squared gains sum to 1; keeps the level constant
+	};
+
+	// The gain of the incoming clip t of the way through the fade
+	float FadeGain( EShape eShape, float t );
+
+	// Fill pFadeIn with an nFrames frame fade's worth of gains; clips
+	// are planar, so every channel uses the same curve. Frame i of a
+	// fade is at t = i / nFrames
+	void FillFadeIn( float * pFadeIn, int nFrames, EShape eShape );
+
+	// Fill pFadeOut with nCount frames of the outgoing gains, starting
+	// nStart frames into the fade, so long fades can be filled a block
+	// at a time rather than stored
+	void FillFadeOut( float * pFadeOut, int nStart, int nCount, int nFrames, EShape eShape );
+
+	const char * GetShapeName( EShape eShape );
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "NullSink.h"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
+
+#include <memory>
+#include <string>
+
+// FileSink
+// A null sink that writes what it pulls to a sound file (WAV, unless
+// the name says otherwise), free running unless it's asked to keep
+// time. Pausing keeps the file open, so the next Start carries on
+// where it left off; a Start after a Stop writes it over. Unlike
+// LoopLauncher::Render this records a live session, commands and
+// all, however the control side happens to drive it.
+class FileSink : public NullSink
+{
+public:
+	FileSink( std::string fileName, bool bClocked );
+	~FileSink() override;
+
+	bool Start( Source * pSource, int nChannels, int nSampleRate ) override;
+	void Stop() override;
+	void Pause() override;
+
+protected:
+	void onBlock( const Chunk& chunk ) override;
+
+private:
+	// The file is only finished (its header written) when it's
+	// destroyed, so it's made by Start and destroyed by Stop; we keep
+	// its format so a paused recording isn't resumed in another one
+	std::string m_FileName;
+	std::unique_ptr<sf::OutputSoundFile> m_pFile;
+	int m_nChannels;
+	int m_nSampleRate;
+};
@@ -1,113 +1,601 @@
 #pragma once
 
-// We override sf::SoundStream
-#include <SFML/Audio/SoundStream.hpp>
-#include <SFML/Audio/SoundBuffer.hpp>
+// Whatever we mix goes to an output sink
+#include "OutputSink.h"
 
-// Each track has an atomic "activeTrack" pointer
-#include <mutex>
+// Clips are either decoded up front or streamed from disk
+#include "Clip.h"
 
+// The control thread talks to the audio thread through
+// a lock free command queue and an atomic boundary flag
+#include <atomic>
+#include "SPSCQueue.h"
+
+#include "FadeCurves.h"
+#include "PlanarBuffer.h"
+#include "VoicePool.h"
+#include "Timeline.h"
+#include "BoundarySignal.h"
+#include "EpochReclaimer.h"
+#include "CallbackStats.h"
+
+#include <array>
 #include <list>
+#include <memory>
 #include <vector>
 #include <map>
 #include <string>
 
 // LoopLauncher
-// Our sf::SoundStream override class that pushes buffers
-// of audio for SFML to play. 
+// The mix engine; it's the source an output sink pulls buffers
+// of audio from (see OutputSink), which is the sound card unless
+// it's been given another one.
 // The LoopLauncher owns a container of tracks; on every getData
 // call each track is given the chance to push its audio onto the
 // buffer. It's up to the track to handle things like loop crossfade.
-class LoopLauncher : public sf::SoundStream
+class LoopLauncher : public OutputSink::Source
 {
 public:
+	// The most channels a stream can have; tracks keep
+	// per channel gain state in arrays this long
+	static constexpr int s_nMaxChannels = 8;
+
+	// Clip handles have 16 bits for the clip's index in its track and
+	// the rest of a positive int for the track's, so past these we'd
+	// hand out handles that alias each other (see MakeClipHandle)
+	static constexpr int s_nMaxTracks = 0x8000;
+	static constexpr int s_nMaxClipsPerTrack = 0x10000;
+
+	// When a track switches clips: at the next line of the launch
+	// grid (see SetLaunchGrid), or when its own loop comes around,
+	// so loops of different lengths can each switch on their own
+	// boundaries. Idle tracks always start on the grid
+	enum class ELaunchMode
+	{
+		Grid,
+		Loop
+	};
+
 	// LoopLauncher::Track
 	// Think of these like loops slots; each track owns a set of
 	// audio clips and designates an active track (the one that
 	// gets pushed onto SFML's audio buffer.) A pending track can
-	// also be set; if the pending track is set, the track crossfades
-	// the end and beginning of buffers that cross the clip transition
-	// so as to avoid the pop associated with audio loops
+	// also be set; when the pending track launches, the clip that was
+	// playing is handed off to a voice (see VoicePool) that keeps it
+	// going as it fades out, and the new one fades in, so as to avoid
+	// the pop associated with audio loops
 	class Track
 	{
 	public:
-		// I may make a class out of this at some point
-		using Clip = sf::SoundBuffer;
+		// Clips are either decoded or streamed (see Clip.h)
+		using Clip = ::Clip;
+
+		// Track::ClipTable
+		// The clips the audio thread plays from. Tables never change
+		// once they're published; adding or removing a clip publishes
+		// a new one, which the audio thread picks up at the start of
+		// its next block, and the old one is retired to the launcher's
+		// EpochReclaimer. Clips keep their index for as long as the
+		// track lives, so removed ones leave a null behind
+		struct ClipTable
+		{
+			std::vector<std::shared_ptr<Clip>> vClips;
+			int nChannels;
+			int nSampleRate;
+		};
 
-		// I need the rvalue functions because sf::SoundBuffer
-		// deletes its copy constructor and assignment operator
+		// The audio thread holds on to tracks by address, so they can't move
 		Track();
 		Track( std::list<std::string> liFileNames );
-		Track( Track&& );
-		Track& operator=( Track&& );
+		Track( const Track& ) = delete;
+		Track& operator=( const Track& ) = delete;
 		
-		// Some useful gets
+		// Some useful gets; the clip count includes removed clips
 		int GetChannelCount() const;
 		int GetSampleRate() const;
-		int GetSampleCount() const;
+		int GetFrameCount() const;
+		int GetClipCount() const;
+		bool IsClipLoaded( int nClip ) const;
+		bool IsClipStreaming( int nClip ) const;
 		bool HasClip( std::string clipName ) const;
+		bool IsPlaying() const;
+		ELaunchMode GetLaunchMode() const;
+
+		// Silent blocks the track's streamed clips have had to play
+		int GetUnderrunCount() const;
 	
-		// Add a track to the map of clips
-		bool AddClip( std::string fileName );
+		// Add a clip to the clip table, returning its
+		// (stable) index within this track or -1 on failure
+		// (which includes there being s_nMaxClipsPerTrack already)
+		// The clip is conformed to the format of our first clip
+		int AddClip( std::string fileName );
+
+		// Same as above, for a clip that's already been loaded
+		// This one doesn't conform the clip (see ConformClip)
+		int AddClip( std::string fileName, Clip clip );
+
+		// Take a clip out of the table; if it's playing it goes
+		// silent at the audio thread's next block
+		bool RemoveClip( std::string clipName );
+
+		// Convert a clip to the given format; this only touches that
+		// clip, so different clips can be conformed in parallel, but
+		// UpdateFormat has to be called once they're all done
+		bool ConformClip( int nClip, int nSampleRate, int nChannels );
+		void UpdateFormat();
+
+		// Same deal as ConformClip, see Clip::Compress
+		bool CompressClip( int nClip, int nLossyBits );
+
+		// Same again, see Clip::ConformTempo and ClipStretch::GetSourceTempo;
+		// this has to come before ConformClip
+		bool ConformClipTempo( int nClip, float fBPM, int nBeatsPerBar );
+
+		// Find a clip's index by name, -1 if we don't have it
+		int GetClipHandle( std::string clipName ) const;
+
+		// The track's index in the launcher, which voices
+		// playing our clips use to find their way back to us
+		void SetHandle( int nHandle );
+
+		// Where replaced clip tables go once we've been handed to the
+		// audio thread; until then there's no one to race with, so
+		// they're freed right away
+		void SetReclaimer( EpochReclaimer * pReclaimer );
+
+		// Called from the audio thread at the start of every block,
+		// before anything else touches the track, to pick up clips
+		// that were added or removed
+		void AcquireClips();
+		bool HasPlayClip( int nClip );
+
+		// These are only called from the audio thread, as it drains
+		// commands sent by LoopLauncher (see LoopLauncher::Command)
+		void StageClip( int nClip );
+		void PostStagedClip();
+		void Launch( VoicePool& voices, int nDelay );
+		void Stop();
+		void SetGain( float fGain );
+		void SetPan( float fPan );
+		void SetFade( int nFadeFrames, FadeCurves::EShape eShape );
+		void SetLaunchMode( ELaunchMode eLaunchMode );
+		void SetTail( int nTailFrames );
+		void StartOneShot( VoicePool& voices, int nClip, float fGain );
+
+		// Fades default to a few milliseconds of equal power, and
+		// can be set per track up to a limit (see SetTrackFade)
+		static constexpr float s_fDefaultFadeMS = 5.f;
+		static constexpr float s_fMaxFadeMS = 250.f;
+		int GetMaxFadeFrames() const;
 
-		// Set the pending track (atomically)
-		bool SetPendingTrack( std::string trackName );
+		// Called at the start of every block, before any GetAudio calls
+		// for it; gain and pan changes ramp linearly across the block
+		void BeginBlock( sf::Int64 nFrame, int nFrames );
 
-		// Write nSamplesDesired samples into pMixBuffer, given nCurSamplePos
-		bool GetAudio( sf::Int16 * pMixBuffer, int nSamplesDesired, int nCurSamplePos );
+		// Jump straight to the gain and pan we've been told to have,
+		// so the next block doesn't ramp to them (see LoopLauncher::Render)
+		void SnapGain();
+
+		// Add nFrames sample frames to the mix bus, given the global frame;
+		// ppMixBus has one pointer per channel, and the bus is normalized.
+		// Clips we switch away from are handed off to voices
+		bool GetAudio( float * const * ppMixBus, int nFrames, sf::Int64 nCurFrame, VoicePool& voices );
+
+		// Add nFrames frames of a voice playing one of our clips to the
+		// mix bus, through our gain ramp; pCurve needs room for nFrames
+		// frames of fade. Returns false once the voice is done
+		bool MixVoice( VoicePool::Voice& voice, float * const * ppMixBus, int nFrames, sf::Int64 nCurFrame, float * pCurve );
 
 	private:
-		int m_nFadeSamples;
-		int m_nSampleCount;
-		std::map<std::string, Clip> m_mapClips;
-		Clip * m_pPendingTrack;
-		Clip * m_pPendingClip;
+		void publishClips( std::shared_ptr<const ClipTable> pClipTable );
+		Clip * getPlayClip( int nClip );
+		int getMaxFadeFrames( int nSampleRate ) const;
+		int getClipSpan( int nClip, int nCursor, const sf::Int16 ** ppChannels );
+		void advanceCursor( int nClip, int& nCursor, int nFrames );
+		void mixSegment( float * const * ppMixBus, int nOffset, int nFrames, sf::Int64 nCurFrame );
+		void buildFadeCurves();
+
+		// The fade in gains, one per frame, and the fade
+		// a SetFade call asked for; that gets built at the next launch
+		// so we never change curves in the middle of a fade. Storage
+		// for the longest fade is reserved up front. The outgoing clip
+		// fades out over the fade or the tail, whichever is longer
+		int m_nFadeFrames;
+		FadeCurves::EShape m_eFadeShape;
+		std::vector<float> m_vFadeIn;
+		int m_nNextFadeFrames;
+		FadeCurves::EShape m_eNextFadeShape;
+		int m_nTailFrames;
+
+		int m_nFrameCount;
+		int m_nHandle;
+
+		// Gain and pan are set by commands, and pan only does anything
+		// in stereo; it's a balance control, so the side we pan towards
+		// stays at full gain. Each channel ramps from the gain it had at
+		// the end of the last block to these over the block that starts
+		// at m_nRampStartFrame, in the mix bus's scale
+		float m_fGain;
+		std::array<float, 2> m_afPanGain;
+		std::array<float, s_nMaxChannels> m_afCurGain;
+		std::array<float, s_nMaxChannels> m_afRampStart;
+		std::array<float, s_nMaxChannels> m_afRampStep;
+		sf::Int64 m_nRampStartFrame;
+
+		// Clips are referred to by their index in the table; the map is
+		// only used to resolve names to indices. The control thread owns
+		// the latest table and publishes it through the atomic pointer,
+		// the audio thread plays from whichever it last picked up.
+		// -1 means no clip (silence) for any of the indices below
+		std::shared_ptr<const ClipTable> m_pClipTable;
+		std::atomic<const ClipTable *> m_pNextClips;
+		const ClipTable * m_pPlayClips;
+		EpochReclaimer * m_pReclaimer;
+		std::map<std::string, int> m_mapClipHandles;
+		int m_nStagedClip;
+		int m_nActiveClip;
+		int m_nPendingClip;
+		ELaunchMode m_eLaunchMode;
+
+		// Where we are in the active clip, and how far into its fade in.
+		// The cursor is frames into the clip, and wraps when it reaches
+		// its end, so every track loops at its own length no matter
+		// where the launcher's grid is
+		int m_nActiveCursor;
+		int m_nFadePos;
 	};
 
+	// Clip handles identify a clip across the whole launcher;
+	// the track handle lives in the high bits, the clip's
+	// index in the track in the low bits
+	static int MakeClipHandle( int nTrack, int nClip );
+	static int GetTrackFromClipHandle( int nClipHandle );
+	static int GetClipFromClipHandle( int nClipHandle );
+
 public:
 
-	// I need these for the same reason Track does
+	// Moves are only safe before Play; the destructor stops the
+	// stream, so the audio thread is done before our members go.
+	// Whatever's moved from is left with a NullSink, and no tracks
 	LoopLauncher();
 	LoopLauncher( LoopLauncher&& );
 	LoopLauncher& operator=( LoopLauncher&& );
+	~LoopLauncher();
 
-	// Call into the sf::SoundStream::initialize function
-	bool Initialize( std::map<std::string, std::list<std::string>> mapTracks );
+	// Load tracks and set up the stream's format
+	// nBlockSize is the number of sample frames rendered per
+	// onGetData call; pass 0 to get s_nDefaultBlockSize
+	bool Initialize( std::map<std::string, std::list<std::string>> mapTracks, int nBlockSize );
+
+	// The block size in sample frames, and how long a block lasts.
+	// SFML keeps a few blocks queued, so output latency is a small
+	// multiple of this; 128 - 512 frames makes for snappy transitions
+	int GetBlockSize() const;
+	float GetBlockDurationMS() const;
+	static constexpr int s_nDefaultBlockSize = 512;
 
 	bool NeedsAudio();
 
+	// Sleep until the audio thread reaches a boundary of the launch
+	// grid, which is when NeedsAudio turns true, or until nTimeoutMS
+	// milliseconds go by (a negative timeout waits forever.) Returns
+	// true if there's been a boundary since this last returned, so
+	// one that went by while the caller was busy isn't missed
+	bool WaitForBoundary( int nTimeoutMS );
+
+	// The pointer is good until the track is removed
 	LoopLauncher::Track * GetTrack( std::string trackName ) const;
 
-	bool AddTrack( std::string trackName, std::list<std::string> liFileNames );
+	// Clips in other formats are conformed to the stream's when they're
+	// loaded (see ClipConform.) The stream's format is whatever the
+	// first clip of the first track is in, unless it's set before
+	// Initialize; this returns false if it's too late for that
+	bool SetStreamFormat( int nSampleRate, int nChannels );
+
+	// How many voices (tails and one-shots, see VoicePool) can play at
+	// once; they're allocated by Initialize, so this has to be set before
+	bool SetVoiceCount( int nVoices );
+	static constexpr int s_nDefaultVoiceCount = 32;
+
+	// Keep clips loaded from now on compressed in memory, dropping
+	// nLossyBits low bits of each sample (see CompressedClipBuffer),
+	// and decode them a block at a time as they play. That costs some
+	// mixing time, but big sets take around half the memory or less;
+	// clips that are already loaded are left as they are. Long clips
+	// that would be streamed get decoded and compressed too, so they
+	// don't touch the disk. Returns false if nLossyBits is too many
+	bool SetClipCompression( bool bCompressClips, int nLossyBits );
+	bool GetClipCompression() const;
+
+	// Stretch clips loaded from now on to fBPM, keeping their pitch
+	// (see ClipStretch), so loops recorded at other tempos and lengths
+	// play in time; 0 turns it off. A clip's own tempo comes from its
+	// name if it says (i.e. "beat_96bpm.wav"), otherwise it's taken to
+	// last a whole number of bars. Stretching is done on the loader
+	// pool and the results are kept on disk (see TempoCache), so the
+	// next time the set loads at this tempo it doesn't happen again.
+	// This doesn't touch the launch grid (see SetLaunchGrid)
+	bool SetProjectTempo( float fBPM, int nBeatsPerBar );
+	float GetProjectTempo() const;
+
+	// Returns the new track's handle, or -1 on failure
+	// Clips are loaded in parallel, as they are by Initialize
+	int AddTrack( std::string trackName, std::list<std::string> liFileNames );
+
+	// Same as above, but with clips that have already been loaded (or
+	// synthesized), keyed by name. Call Initialize after adding tracks
+	// this way with an empty map to set up the stream
+	int AddTrack( std::string trackName, std::map<std::string, Clip> mapClips );
+
+	// Take a track out; it goes silent at the audio thread's next
+	// block, and its handle and clip handles are never reused. Tracks
+	// can be added and removed while we're playing
+	bool RemoveTrack( std::string trackName );
+
+	// Add a clip to a track that has at least one already, or remove
+	// one; these work while we're playing too. The new clip is
+	// conformed to the stream's format, and the returned handle is
+	// the same as GetClipHandle's (or -1 on failure)
+	int AddClip( std::string trackName, std::string fileName );
+	bool RemoveClip( std::string clipName );
+
+	// The files that failed to load in the last Initialize or AddTrack
+	std::list<std::string> GetLoadFailures() const;
+
+	// Resolve names to integer handles; these are stable
+	// for the life of the launcher, so cache them
+	int GetTrackHandle( std::string trackName ) const;
+	int GetClipHandle( std::string clipName ) const;
 
 	//bool UpdatePendingTracks( std::map<std::string, std::string> mapNewActiveClips, bool bPost = false );
 	bool UpdatePendingClips( std::list<std::string> liNewActiveClips );
 
-	// This calls teh sf::SoundStream::play function
-	// after flushing any pending clips
+	// Same as above, but with handles from GetClipHandle (no string lookups)
+	bool UpdatePendingClipHandles( std::list<int> liNewActiveClips );
+
+	// What the launch grid is quantized to; clips launch on the
+	// next boundary of the grid. Loop means the longest track
+	enum class ELaunchQuantum
+	{
+		Loop,
+		Bar,
+		Beat
+	};
+
+	// Set the launch grid; Bar and Beat need a tempo, and Bar needs
+	// a meter. The grid is anchored at frame 0 of playback, so changing
+	// it mid-stream keeps boundaries in phase with what's playing
+	bool SetLaunchGrid( ELaunchQuantum eQuantum, float fBPM, int nBeatsPerBar );
+
+	// Schedule clips to become pending at a play frame, exactly as if
+	// UpdatePendingClips had been called right then; they launch on the
+	// first grid line at or after it (or at the end of their own loop.)
+	// Many of these can be lined up ahead of time, so transitions land
+	// on time however late the control thread gets; frames that have
+	// already gone by make the clips pending right away. Returns false
+	// if nothing got scheduled
+	bool ScheduleClips( sf::Int64 nFrame, std::list<std::string> liClips );
+	bool ScheduleClipHandles( sf::Int64 nFrame, std::list<int> liClipHandles );
+
+	// Same as above, but on the nGridLine'th line of the launch grid,
+	// counting from frame 0. The line's frame is worked out from the
+	// grid as it is now, so scheduled lines don't move if it changes
+	bool ScheduleClipsOnGrid( sf::Int64 nGridLine, std::list<std::string> liClips );
+
+	// Drop everything that's scheduled but hasn't happened yet
+	bool ClearSchedule();
+
+	// How many frames the audio thread has mixed (which is a few blocks
+	// ahead of what's been heard), and the first grid line at or after
+	// that, which is the soonest one clips can still be scheduled on
+	sf::Int64 GetPlayFrame() const;
+	sf::Int64 GetNextGridLine() const;
+
+	// Silence a track immediately, or change its gain or pan (-1 is
+	// left, 1 is right); changes ramp in over the next block
+	bool StopTrack( std::string trackName );
+	bool SetTrackGain( std::string trackName, float fGain );
+	bool SetTrackPan( std::string trackName, float fPan );
+
+	// Set how long and what shape a track's crossfades are;
+	// takes effect at the track's next launch
+	bool SetTrackFade( std::string trackName, float fFadeMS, FadeCurves::EShape eShape );
+
+	// Set whether a track switches clips on the grid or at the end of
+	// its own loop; takes effect at the track's next switch
+	bool SetTrackLaunchMode( std::string trackName, ELaunchMode eLaunchMode );
+
+	// Let the clip a track switches away from ring out for this long
+	// as it fades, rather than just the length of the crossfade
+	bool SetTrackTail( std::string trackName, float fTailMS );
+
+	// Play a clip through once on top of whatever its track is playing,
+	// starting with the next block; it goes through the track's gain
+	// and pan, and stops if the track does. Streamed clips can't be
+	// played this way, since they can only be read from one place
+	bool TriggerClip( std::string clipName, float fGain );
+
+	// Render nFrames sample frames to a WAV file offline, as fast as
+	// possible; mapEvents maps frames to UpdatePendingClips calls.
+	// Settings sent before this (gains, fades and so on) are kept, but
+	// clips made pending or scheduled before it are dropped
+	bool Render( std::string fileName, int nFrames, std::map<int, std::list<std::string>> mapEvents );
+
+	// What the audio callback has been up to (see CallbackStats);
+	// the summary also has the streamed clips' underruns and the
+	// callback's mean and peak load as a fraction of the block duration
+	std::map<std::string, double> GetStats() const;
+	std::vector<int> GetStatsHistogram( std::string histogramName ) const;
+	void ResetStats();
+
+	// Where the audio goes; an SFMLSink (the audio device) unless this
+	// is given something else, which it can't be while we're playing
+	bool SetOutputSink( std::unique_ptr<OutputSink> pSink );
+
+	// This starts the output sink after flushing any pending clips
 	void Play();
 
-	// sf::SoundStream overrides
+	// Pausing and stopping the sink both leave the mix where it is,
+	// so Play picks up from there; only a device can really pause
+	void Pause();
+	void Stop();
+	bool IsPlaying() const;
+
+	// The stream's format, once Initialize has set it up
+	int GetChannelCount() const;
+	int GetSampleRate() const;
+
+	// The sink's volume, 0 to 100; only a device has one
+	void SetVolume( float fVolume );
+	float GetVolume() const;
+
+	// OutputSink::Source override, called on the sink's thread
 protected:
-	bool onGetData( sf::SoundStream::Chunk& ) override;
-	void onSeek( sf::Time ) override;
+	bool onGetData( OutputSink::Chunk& chunk ) override;
 
 private:
-	int m_nLastSamplePos;
-	int m_nMaxSampleCount;
-	std::map<std::string, LoopLauncher::Track> m_mapTracks;
-	std::vector<sf::Int16> m_vMixBuffer;
+	std::unique_ptr<OutputSink> m_pSink;
+	int m_nMaxFrameCount;
+	int m_nBlockSize;
+
+	// The launch grid. The play frame counts every frame we've rendered,
+	// the grid spacing is in (possibly fractional) frames, and the next
+	// boundary is the grid line we're rendering towards
+	sf::Int64 m_nPlayFrame;
+	double m_dGridFrames;
+	sf::Int64 m_nNextBoundaryFrame;
+	bool m_bPendingUpdate;
+	double computeGridFrames( ELaunchQuantum eQuantum, float fBPM, int nBeatsPerBar ) const;
+
+	// The control thread's copy of the grid spacing, which it uses to
+	// schedule on grid lines, and the play frame as of the last block
+	double m_dControlGridFrames;
+	std::atomic<sf::Int64> m_nPlayedFrame;
+
+	// Clips scheduled ahead of time; the mix loop splits its segments
+	// at the events' frames, so each is applied on the frame it's for
+	static constexpr int s_nTimelineEvents = 1024;
+	Timeline m_Timeline;
+	void applyTimeline();
+
+	// LoopLauncher::TrackTable
+	// The tracks the audio thread mixes, by handle. Like a track's
+	// clips (see Track::ClipTable) this never changes once it's been
+	// published; adding or removing a track publishes a new one. The
+	// handles aren't reused, so removed tracks leave a null behind
+	struct TrackTable
+	{
+		std::vector<std::shared_ptr<Track>> vTracks;
+	};
+
+	// The control thread owns the latest table and publishes it through
+	// the atomic pointer; the audio thread mixes whichever one it picked
+	// up at the start of the block, and the reclaimer frees the old ones
+	// (and the tracks and clips only they had) once it's done with them
+	EpochReclaimer m_Reclaimer;
+	std::shared_ptr<const TrackTable> m_pTrackTable;
+	std::atomic<const TrackTable *> m_pNextTracks;
+	const TrackTable * m_pPlayTracks;
+	std::map<std::string, int> m_mapTrackHandles;
+	void publishTracks( std::shared_ptr<const TrackTable> pTrackTable );
+	Track * getTrack( int nTrack ) const;
+	Track * getPlayTrack( int nTrack );
+	void acquireTracks();
+
+	// Clips get loaded on the ClipLoader pool, then tracks get built
+	// from them; loadClips returns the clips that loaded by name, and
+	// publishTrack hands a built track to the audio thread
+	std::map<std::string, Clip> loadClips( const std::map<std::string, std::list<std::string>>& mapTracks );
+	std::shared_ptr<Track> assembleTrack( const std::list<std::string>& liFileNames, std::map<std::string, Clip>& mapClips );
+	int publishTrack( std::string trackName, std::shared_ptr<Track> pTrack );
+	std::list<std::string> m_liLoadFailures;
+
+	// The format clips get conformed to, or 0 if it's not been picked
+	int m_nStreamSampleRate;
+	int m_nStreamChannels;
+	bool m_bCompressClips;
+	int m_nLossyBits;
+	float m_fProjectBPM;
+	int m_nProjectBeatsPerBar;
+	void conformTracks( const std::vector<std::shared_ptr<Track>>& vTracks );
+
+	// Tracks are summed into a planar float bus, which gets limited,
+	// converted to Int16 and interleaved in the output buffer that
+	// SFML plays from; that's the only place samples get interleaved.
+	// The bus starts with the limiter's lookahead, the tail end of
+	// the last block, and tracks mix in after that
+	PlanarBuffer<float> m_MixBus;
+	std::vector<sf::Int16> m_vOutputBuffer;
+	void limitAndConvert( int nFrames );
+
+	// Voices get mixed after the tracks in every segment
+	int m_nVoiceCount;
+	VoicePool m_Voices;
+	void mixVoices( float * const * ppMixBus, int nFrames );
+
+	// Recorded by the audio thread; the last callback time is in
+	// steady clock nanoseconds, or 0 if we've just (re)started playing
+	CallbackStats m_Stats;
+	std::atomic<long long> m_nLastCallbackNS;
+
+	// The mixing path, used by onGetData and Render
+	void renderBlock( int nFrames );
+	void resetPlayback();
+
+	// Limiter and dither state
+	static constexpr float s_fLimiterCeiling = 0.98f;
+	static constexpr float s_fLimiterAttackSeconds = 0.002f;
+	static constexpr float s_fLimiterReleaseSeconds = 0.15f;
+	static constexpr int s_nDitherTableSize = 8192;
+	float m_fLimiterGain;
+	int m_nLimiterFrames;
+	std::vector<float> m_vDither;
+	int m_nDitherPos;
+
+	// LoopLauncher::Command
+	// Everything the control thread wants the audio thread
+	// to do goes through one of these. They're POD so they
+	// can live in the SPSC queue without allocating
+	struct Command
+	{
+		enum class EType
+		{
+			PendingClip,	// Stage nClip to play on nTrack at the next boundary
+			Stop,			// Silence nTrack right away
+			Gain,			// Set nTrack's gain to dValue
+			Pan,			// Set nTrack's pan to dValue
+			Grid,			// Set the launch grid spacing to dValue frames
+			Fade,			// Set nTrack's fade to dValue frames of shape nClip
+			LaunchMode,		// Set nTrack's launch mode to nClip
+			Tail,			// Set nTrack's tail to dValue frames
+			OneShot,		// Play nClip on nTrack once, at gain dValue
+			Schedule,		// Stage nClip on nTrack when we get to frame dValue
+			Unschedule		// Drop everything on the timeline
+		};
+		EType eType;
+		int nTrack;
+		int nClip;
+		double dValue;
+	};
 
 	// These are the things shared between the audio thread and others
-	// Protected by the mutex, the needsAudio bool gets set after the 
-	// full loop cycle (meaning the longest track) repeats, meaning that
-	// is the "trigger resolution" of loops. 
-	// The map is used to store pending tracks, which get updated in the 
-	// tracks while the mutex is locked
-	std::mutex m_muTrackUpdate;
-	bool m_bNeedsAudio;
-	std::map<std::string, std::string> m_mapPendingTracks;
-	void postPendingTracks();
+	// Commands are pushed by the control thread and drained at the start
+	// of every onGetData call, so the audio thread never waits on a lock.
+	// The needsAudio flag gets set at every boundary of the launch grid,
+	// meaning that is the "trigger resolution" of loops. Scheduling
+	// a few loops ahead sends a command per clip, hence the room
+	SPSCQueue<Command, 1024> m_qCommands;
+	std::atomic<bool> m_bNeedsAudio;
+
+	// Signalled along with the needsAudio flag, so the control thread
+	// can sleep until then; the seen count is the control thread's
+	BoundarySignal m_BoundarySignal;
+	unsigned int m_uSeenBoundaries;
+	bool pushCommand( Command cmd );
+	void processCommands();
+	void postStagedLoopClips();
+	void launchPendingTracks();
+	sf::Int64 getNextBoundaryFrame( sf::Int64 nFrame ) const;
 
 	// PyLiaison static init func
 public:
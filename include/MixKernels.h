@@ -0,0 +1,63 @@
+#pragma once
+
+// sf::Int16
+#include <SFML/Config.hpp>
+
+// MixKernels
+// The inner loops of the mixer. Every kernel has a scalar
+// reference implementation plus SSE2 and AVX2 versions; the
+// best one the CPU supports is picked the first time any of
+// them are called. All versions do exactly the same float
+// operations in the same order, so their output is bit exact
+// with the scalar path (which is why MixKernels.cpp must be
+// built without floating point contraction.)
+//
+// Tracks are mixed into a planar float bus, and the bus is
+// only turned back into interleaved sf::Int16 samples by ToInt16.
+namespace MixKernels
+{
+	// Instruction sets we have kernels for
+	enum class EISA
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	// The mix kernels work on one channel at a time, since the clips and
+	// the bus are planar (see PlanarBuffer), and apply a linear gain ramp
+	// g[i] = fGain0 + i * fGainStep across the frames
+
+	// pDst[i] += pSrc[i] * g[i]
+	void Accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep );
+
+	// pDst[i] += (pCurve[i] * pSrc[i]) * g[i]
+	// Accumulate through a fade, in or out; pCurve holds the fade's
+	// gain for each frame (see FadeCurves)
+	void ApplyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve );
+
+	// max( |pSrc[i]| )
+	float PeakAbs( const float * pSrc, int nSamples );
+
+	// Interleave nChannels planes of nFrames into pDst, so that sample
+	// k = i * nChannels + c (channel c of frame i) is
+	//   pDst[k] = round( saturate( ppSrc[c][i] * g[i] * 32767 + pDither[k] ) )
+	// The bus is expected to be normalized to [-1, 1], and pDither is in
+	// Int16 LSBs. Mono and stereo have vector paths, anything else is scalar
+	void ToInt16( sf::Int16 * pDst, const float * const * ppSrc, int nChannels, int nFrames, float fGain0, float fGainStep, const float * pDither );
+
+	// sum( pA[i] * pB[i] ), where nSamples is a multiple of 8. The sum is
+	// kept in 8 partial sums (one per i % 8) that are added up pairwise
+	// at the end, so the vector versions can stay bit exact
+	float DotProduct( const float * pA, const float * pB, int nSamples );
+
+	// The best instruction set this machine supports
+	EISA GetBestISA();
+
+	// The instruction set the kernels above dispatch to, which
+	// defaults to the best one. Setting something the CPU doesn't
+	// support returns false and leaves the current one in place.
+	EISA GetISA();
+	bool SetISA( EISA eISA );
+	const char * GetISAName( EISA eISA );
+}
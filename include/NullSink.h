@@ -0,0 +1,41 @@
+#pragma once
+
+#include "OutputSink.h"
+
+#include <atomic>
+#include <thread>
+
+// NullSink
+// Pulls blocks on a thread of its own and throws them away, so the
+// engine can run with no audio device at all. A clocked sink pulls a
+// block every block's worth of real time, the way a device would, so
+// the control side behaves as it does live; a free running one pulls
+// them as fast as they can be mixed, for benchmarks and rendering.
+class NullSink : public OutputSink
+{
+public:
+	explicit NullSink( bool bClocked );
+	~NullSink() override;
+
+	bool Start( Source * pSource, int nChannels, int nSampleRate ) override;
+	void Stop() override;
+	bool IsPlaying() const override;
+
+	// How many frames we've pulled, in total
+	sf::Int64 GetFrameCount() const;
+
+protected:
+	// Called on our thread with every block we pull
+	virtual void onBlock( const Chunk& chunk );
+
+private:
+	void run();
+
+	bool m_bClocked;
+	Source * m_pSource;
+	int m_nChannels;
+	int m_nSampleRate;
+	std::thread m_Thread;
+	std::atomic<bool> m_bRunning;
+	std::atomic<sf::Int64> m_nFrames;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SFML/Config.hpp>
+
+#include <cstddef>
+
+// OutputSink
+// Where the mixed audio goes. The launcher doesn't know whether it's
+// feeding a sound card, a file or nothing at all; it's a Source, and
+// a sink pulls blocks of interleaved Int16 samples from it on a thread
+// of its own, which is the audio thread as far as the mixer's rules
+// go. That's what lets the same engine run headless (in benchmarks,
+// on render boxes) and lets new sinks be tried without touching it.
+//
+// The sinks we have are SFMLSink (the audio device, through SFML's
+// buffering), NullSink (which throws the audio away, either as fast as
+// it's mixed or at the pace a device would take it) and FileSink.
+class OutputSink
+{
+public:
+	// A block of interleaved samples, good until the next one is pulled
+	struct Chunk
+	{
+		const sf::Int16 * pSamples;
+		std::size_t nSamples;
+	};
+
+	// What sinks pull from; returning false means there's nothing
+	// left to play, and the sink stops
+	class Source
+	{
+	public:
+		virtual ~Source() {}
+		virtual bool onGetData( Chunk& chunk ) = 0;
+	};
+
+	virtual ~OutputSink() {}
+
+	// Start pulling from pSource, whose blocks are in this format;
+	// returns false if the sink couldn't be started
+	virtual bool Start( Source * pSource, int nChannels, int nSampleRate ) = 0;
+
+	// Stop pulling; once this returns the source won't be called
+	virtual void Stop() = 0;
+
+	// Sinks that can't pause just stop, which amounts to the same
+	// thing since Start picks up wherever the source is
+	virtual void Pause();
+
+	virtual bool IsPlaying() const = 0;
+
+	// Only a device has a volume (0 to 100); the other sinks keep
+	// hold of it, but the audio they get is exactly what was mixed
+	virtual void SetVolume( float fVolume );
+	virtual float GetVolume() const;
+
+protected:
+	OutputSink();
+
+private:
+	float m_fVolume;
+};
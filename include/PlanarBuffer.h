@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+// AlignedAllocator
+// A std::allocator that hands out memory aligned to nAlignment
+// bytes, so vectors of samples can be read with aligned SIMD loads
+template <typename T, size_t nAlignment>
+struct AlignedAllocator
+{
+	using value_type = T;
+
+	template <typename U>
+	struct rebind
+	{
+		using other = AlignedAllocator<U, nAlignment>;
+	};
+
+	AlignedAllocator() {}
+
+	template <typename U>
+	AlignedAllocator( const AlignedAllocator<U, nAlignment>& ) {}
+
+	T * allocate( size_t nCount )
+	{
+#ifdef _WIN32
+		void * pMem = _aligned_malloc( nCount * sizeof( T ), nAlignment );
+#else
+		void * pMem = nullptr;
+		if ( posix_memalign( &pMem, nAlignment, nCount * sizeof( T ) ) != 0 )
+			pMem = nullptr;
+#endif
+		if ( pMem == nullptr )
+			throw std::bad_alloc();
+
+		return (T *) pMem;
+	}
+
+	void deallocate( T * pMem, size_t )
+	{
+#ifdef _WIN32
+		_aligned_free( pMem );
+#else
+		free( pMem );
+#endif
+	}
+
+	template <typename U>
+	bool operator==( const AlignedAllocator<U, nAlignment>& ) const { return true; }
+
+	template <typename U>
+	bool operator!=( const AlignedAllocator<U, nAlignment>& ) const { return false; }
+};
+
+// PlanarBuffer
+// Multichannel audio stored one channel after another (planar)
+// rather than interleaved, so each channel is a contiguous run of
+// samples the mix kernels can stream through. It's one allocation,
+// and every channel starts on an s_nAlignment byte boundary; the
+// stride between channels is the frame count rounded up to make
+// that so. Positions are always in frames.
+template <typename T>
+class PlanarBuffer
+{
+public:
+	static constexpr size_t s_nAlignment = 32;
+
+	PlanarBuffer() :
+		m_nChannels( 0 ),
+		m_nFrames( 0 ),
+		m_nStride( 0 )
+	{
+	}
+
+	// Reallocate for nChannels channels of nFrames frames, all zeroes
+	void Resize( int nChannels, int nFrames )
+	{
+		const int nPerAlignment = (int) (s_nAlignment / sizeof( T ));
+		m_nChannels = std::max( 0, nChannels );
+		m_nFrames = std::max( 0, nFrames );
+		m_nStride = (m_nFrames + nPerAlignment - 1) / nPerAlignment * nPerAlignment;
+		m_vData.assign( size_t( m_nChannels ) * m_nStride, T( 0 ) );
+	}
+
+	int GetChannelCount() const
+	{
+		return m_nChannels;
+	}
+
+	int GetFrameCount() const
+	{
+		return m_nFrames;
+	}
+
+	bool IsEmpty() const
+	{
+		return m_vData.empty();
+	}
+
+	T * GetChannel( int nChannel )
+	{
+		return m_vData.data() + size_t( nChannel ) * m_nStride;
+	}
+
+	const T * GetChannel( int nChannel ) const
+	{
+		return m_vData.data() + size_t( nChannel ) * m_nStride;
+	}
+
+	// Copy nFrames frames of interleaved samples in, starting at nFrame
+	void Deinterleave( const T * pSrc, int nFrame, int nFrames )
+	{
+		for ( int c = 0; c < m_nChannels; c++ )
+		{
+			T * pDst = GetChannel( c ) + nFrame;
+			for ( int i = 0; i < nFrames; i++ )
+				pDst[i] = pSrc[i * m_nChannels + c];
+		}
+	}
+
+	// The opposite of the above
+	void Interleave( T * pDst, int nFrame, int nFrames ) const
+	{
+		for ( int c = 0; c < m_nChannels; c++ )
+		{
+			const T * pSrc = GetChannel( c ) + nFrame;
+			for ( int i = 0; i < nFrames; i++ )
+				pDst[i * m_nChannels + c] = pSrc[i];
+		}
+	}
+
+private:
+	int m_nChannels;
+	int m_nFrames;
+	int m_nStride;
+	std::vector<T, AlignedAllocator<T, s_nAlignment>> m_vData;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "OutputSink.h"
+
+#include <SFML/Audio/SoundStream.hpp>
+
+// SFMLSink
+// Plays through the audio device with an sf::SoundStream, which pulls
+// a block whenever SFML's queue of buffers needs topping up; output
+// latency is a few blocks. This is the launcher's default sink.
+class SFMLSink : public OutputSink, private sf::SoundStream
+{
+public:
+	SFMLSink();
+	~SFMLSink() override;
+
+	bool Start( Source * pSource, int nChannels, int nSampleRate ) override;
+	void Stop() override;
+	void Pause() override;
+	bool IsPlaying() const override;
+
+	void SetVolume( float fVolume ) override;
+	float GetVolume() const override;
+
+	// sf::SoundStream overrides
+protected:
+	bool onGetData( sf::SoundStream::Chunk& c ) override;
+	void onSeek( sf::Time t ) override;
+
+private:
+	Source * m_pSource;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+
+// SPSCQueue
+// A fixed capacity, wait-free ring buffer meant to be shared
+// by exactly one producer thread and exactly one consumer thread.
+// The producer only ever writes the tail index and the consumer
+// only ever writes the head index, so neither side needs a lock;
+// the acquire / release pairs below make sure the slot contents
+// are visible before the index that publishes them.
+// N must be a power of two so we can mask instead of mod.
+template <typename T, size_t N>
+class SPSCQueue
+{
+	static_assert( N > 0 && (N & (N - 1)) == 0, "SPSCQueue capacity must be a power of two" );
+
+public:
+	SPSCQueue() :
+		m_nHead( 0 ),
+		m_nTail( 0 )
+	{
+	}
+
+	// Neither of these make sense for something shared between threads
+	SPSCQueue( const SPSCQueue& ) = delete;
+	SPSCQueue& operator=( const SPSCQueue& ) = delete;
+
+	// Called from the producer thread; returns false
+	// (without blocking) if the queue is full
+	bool Push( const T& item )
+	{
+		const size_t nTail = m_nTail.load( std::memory_order_relaxed );
+		if ( nTail - m_nHead.load( std::memory_order_acquire ) == N )
+			return false;
+
+		m_aItems[nTail & (N - 1)] = item;
+		m_nTail.store( nTail + 1, std::memory_order_release );
+
+		return true;
+	}
+
+	// Called from the consumer thread; returns false
+	// (without blocking) if there was nothing to pop
+	bool Pop( T& item )
+	{
+		const size_t nHead = m_nHead.load( std::memory_order_relaxed );
+		if ( nHead == m_nTail.load( std::memory_order_acquire ) )
+			return false;
+
+		item = m_aItems[nHead & (N - 1)];
+		m_nHead.store( nHead + 1, std::memory_order_release );
+
+		return true;
+	}
+
+	// Only a hint when called from the producer
+	bool Empty() const
+	{
+		return m_nHead.load( std::memory_order_acquire ) == m_nTail.load( std::memory_order_acquire );
+	}
+
+private:
+	// Keep the indices on separate cache lines so the
+	// two threads aren't fighting over the same one
+	alignas(64) std::atomic<size_t> m_nHead;
+	alignas(64) std::atomic<size_t> m_nTail;
+	std::array<T, N> m_aItems;
+};
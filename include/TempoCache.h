@@ -0,0 +1,40 @@
+#pragma once
+
+#include <SFML/Config.hpp>
+
+#include <string>
+
+// TempoCache
+// Keeps clips that have been stretched to another tempo (see
+// ClipStretch) on disk, as sound files named after a hash of the
+// source file's contents and the two tempos, so a set that's been
+// loaded at a tempo once starts about as fast as one that wasn't
+// stretched at all. Hashing the contents rather than going by name
+// means an edited file gets stretched again, and renamed or copied
+// files don't. Files are written under a temporary name and renamed
+// into place, so loader threads (or other processes) sharing the
+// folder never see half of one. This is all thread safe, and stretches
+// of the same file and tempos wait for each other instead of doing the
+// work twice; none of it is meant for the audio thread.
+namespace TempoCache
+{
+	// The path of fileName stretched from fSrcBPM to fDstBPM, which
+	// gets made (and kept) if it isn't there already; empty if that
+	// couldn't be done (i.e. the folder can't be written to)
+	std::string Acquire( std::string fileName, float fSrcBPM, float fDstBPM );
+
+	// Where the files go, which is made when it's needed. This defaults
+	// to a folder in the system's temp folder, and an empty one turns
+	// the cache off (Acquire always fails, so clips get stretched in
+	// memory every time they're loaded)
+	void SetDirectory( std::string dirName );
+	std::string GetDirectory();
+
+	// 64 bit FNV-1a of a file's contents, 0 if it can't be read
+	sf::Uint64 HashFile( std::string fileName );
+
+	// How many Acquire calls found their file already made, and how
+	// many had to make it
+	int GetHitCount();
+	int GetMissCount();
+}
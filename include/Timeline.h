@@ -0,0 +1,64 @@
+#pragma once
+
+#include <SFML/Config.hpp>
+
+#include <atomic>
+#include <vector>
+
+// Timeline
+// Clips scheduled to become pending at a given play frame, so that
+// the control thread can line up transitions several loops ahead
+// rather than making one UpdatePendingClips call per boundary and
+// hoping it gets there in time. Events come over on the command
+// queue and wait here, sorted by frame, until the audio thread
+// reaches them (see LoopLauncher::ScheduleClips.)
+//
+// The events live in a fixed number of slots, allocated by Reserve
+// before playback starts, so the audio thread never allocates to
+// schedule one. If they're all full, new events get dropped.
+class Timeline
+{
+public:
+	struct Event
+	{
+		sf::Int64 nFrame;	// The play frame the clip becomes pending at
+		int nTrack;			// The track to stage the clip on
+		int nClip;			// The clip's index in the track
+	};
+
+	Timeline();
+	Timeline( Timeline&& );
+	Timeline& operator=( Timeline&& );
+
+	// Make room for nEvents events; everything scheduled is dropped
+	void Reserve( int nEvents );
+
+	// Capacity is fixed by Reserve; these two are atomic,
+	// so they can be read while the audio thread runs
+	int GetCapacity() const;
+	int GetEventCount() const;
+	int GetDroppedCount() const;
+
+	// Everything below is only called from the audio thread
+
+	// Add an event, after any others on the same frame; returns false
+	// (and counts it as dropped) if there's no room left
+	bool Insert( const Event& event );
+
+	// The frame of the earliest event, or the largest Int64 if there
+	// are none; it's what the mix loop splits its segments at
+	sf::Int64 GetNextFrame() const;
+
+	// Take out the earliest event if it's due by nFrame
+	bool Pop( sf::Int64 nFrame, Event& event );
+
+	void Clear();
+
+private:
+	// Kept sorted latest first, so the next event is at the back
+	// and popping it is cheap; inserting shifts the later ones down
+	std::vector<Event> m_vEvents;
+	int m_nCapacity;
+	std::atomic<int> m_nEvents;
+	std::atomic<int> m_nDropped;
+};
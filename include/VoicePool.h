@@ -0,0 +1,77 @@
+#pragma once
+
+#include "FadeCurves.h"
+
+#include <atomic>
+#include <vector>
+
+// VoicePool
+// Voices play a track's clips on top of whatever the track itself
+// is playing: the tail of a clip the track just switched away from,
+// which keeps ringing while it fades out under the new one, or a
+// one-shot that plays a clip through once. Voices belong to the
+// launcher, but mix through their track, so they pick up its gain
+// and pan (see LoopLauncher::Track::MixVoice.)
+//
+// There are a fixed number of voices, allocated by Reserve before
+// playback starts, so the audio thread never allocates to start one.
+// If they're all busy, the one closest to finishing gets stolen and
+// is cut off in favor of the new one.
+class VoicePool
+{
+public:
+	struct Voice
+	{
+		int nTrack;			// The track whose clip we play, -1 if free
+		int nClip;			// The clip's index in the track
+		int nCursor;		// Where we are in the clip
+		int nDelay;			// Frames to wait before starting, within the current segment
+		int nFramesLeft;	// Until we're done
+		int nFadeFrames;	// If we're fading out, how long the whole fade is; otherwise 0
+		FadeCurves::EShape eShape;
+		float fGain;
+	};
+
+	VoicePool();
+	VoicePool( VoicePool&& );
+	VoicePool& operator=( VoicePool&& );
+
+	// Allocate nVoices voices and a curve buffer long
+	// enough for nBlockSize frames; everything starts free
+	void Reserve( int nVoices, int nBlockSize );
+
+	// Capacity is fixed by Reserve; these two are atomic,
+	// so they can be read while the audio thread runs
+	int GetCapacity() const;
+	int GetActiveCount() const;
+	int GetStolenCount() const;
+
+	// Everything below is only called from the audio thread
+
+	// Keep nClip playing from nCursor on nTrack, fading out over
+	// nFadeFrames frames; the fade starts nDelay frames from now
+	void StartTail( int nTrack, int nClip, int nCursor, int nDelay, int nFadeFrames, FadeCurves::EShape eShape );
+
+	// Play nFrames frames of nClip on nTrack from its start, once
+	void StartOneShot( int nTrack, int nClip, int nFrames, float fGain );
+
+	// Silence the voices playing on a track, or one of its clips
+	void StopTrack( int nTrack );
+	void StopClip( int nTrack, int nClip );
+	void Clear();
+
+	// Voices are mixed by walking these; call Release on the
+	// ones that are done. The curve buffer is scratch space
+	// for the fade, with room for a block's worth of frames
+	std::vector<Voice>& GetVoices();
+	void Release( Voice& voice );
+	float * GetCurve();
+
+private:
+	Voice& acquire();
+
+	std::vector<Voice> m_vVoices;
+	std::vector<float> m_vCurve;
+	std::atomic<int> m_nActive;
+	std::atomic<int> m_nStolen;
+};
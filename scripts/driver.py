@@ -197,8 +197,13 @@ def SomberCoro():
         yield toSomberCh1
         yield toSomberCh3
 
+# Sample frames rendered per audio callback; smaller
+# means snappier transitions but more callback overhead
+BLOCK_SIZE = 256
+
 g_StateGraph = None
 g_SomberCoro = None
+g_ClipHandles = None
 
 def Initialize(pLoopLauncher):
     global g_StateGraph
@@ -206,14 +211,21 @@ def Initialize(pLoopLauncher):
     trackMap = g_StateGraph.GetValueMap()
 
     ll = LoopLauncher(pLoopLauncher)
-    ll.Initialize(trackMap)
+    ll.Initialize(trackMap, BLOCK_SIZE)
+    for fileName in ll.GetLoadFailures():
+        print('Failed to load', fileName)
+
+    # Cache the integer handle of every clip so
+    # Update doesn't have to do any string lookups
+    global g_ClipHandles
+    g_ClipHandles = {clip : ll.GetClipHandle(clip) for clips in trackMap.values() for clip in clips}
 
     global g_SomberCoro
     g_SomberCoro = SomberCoro()
     next(g_SomberCoro)
 
-    nextClips = list(c[1] for c in g_StateGraph.GetNextState())
-    ll.UpdatePendingClips(nextClips)
+    nextClips = list(g_ClipHandles[c[1]] for c in g_StateGraph.GetNextState())
+    ll.UpdatePendingClipHandles(nextClips)
 
     ll.Play()
 
@@ -243,7 +255,7 @@ def Update(pLoopLauncher):
         stimulus = next(g_SomberCoro)
         g_StateGraph.SetStimulus(stimulus)
 
-        nextClips = list(c[1] for c in g_StateGraph.GetNextState())
-        ll.UpdatePendingClips(nextClips)
+        nextClips = list(g_ClipHandles[c[1]] for c in g_StateGraph.GetNextState())
+        ll.UpdatePendingClipHandles(nextClips)
 
     return True
\ No newline at end of file
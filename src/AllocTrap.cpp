@@ -0,0 +1,199 @@
+#include "AllocTrap.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef LL_ALLOC_TRAP
+
+// glibc exports its allocator under these names too, so we can wrap
+// the C allocation functions and still get at the real ones; that
+// catches what doesn't go through operator new (AlignedAllocator, etc.)
+#if defined( __GLIBC__ )
+extern "C"
+{
+	void * __libc_malloc( size_t );
+	void * __libc_calloc( size_t, size_t );
+	void * __libc_realloc( void *, size_t );
+	void * __libc_memalign( size_t, size_t );
+	void __libc_free( void * );
+}
+#define LL_RAW_MALLOC __libc_malloc
+#define LL_RAW_FREE __libc_free
+#else
+#define LL_RAW_MALLOC std::malloc
+#define LL_RAW_FREE std::free
+#endif
+
+namespace
+{
+	// How many scopes the thread is in; this is a plain int
+	// so that touching it never needs the heap itself
+	thread_local int t_nScopeDepth = 0;
+
+	std::atomic<bool> g_bAbort( true );
+	std::atomic<int> g_nTraps( 0 );
+
+	void checkAlloc( const char * szWhat )
+	{
+		if ( t_nScopeDepth == 0 )
+			return;
+
+		g_nTraps.fetch_add( 1, std::memory_order_relaxed );
+		if ( g_bAbort.load( std::memory_order_relaxed ) == false )
+			return;
+
+		// Leave the scope so printing can allocate if it wants to
+		t_nScopeDepth = 0;
+		std::fprintf( stderr, "AllocTrap: %s on the audio thread\n", szWhat );
+		std::abort();
+	}
+}
+
+AllocTrap::Scope::Scope()
+{
+	t_nScopeDepth++;
+}
+
+AllocTrap::Scope::~Scope()
+{
+	t_nScopeDepth--;
+}
+
+bool AllocTrap::IsEnabled()
+{
+	return true;
+}
+
+void AllocTrap::SetAbort( bool bAbort )
+{
+	g_bAbort.store( bAbort );
+}
+
+int AllocTrap::GetTrapCount()
+{
+	return g_nTraps.load( std::memory_order_relaxed );
+}
+
+// The C allocation functions, wrapped around glibc's own
+#if defined( __GLIBC__ )
+extern "C"
+{
+	void * malloc( size_t nBytes )
+	{
+		checkAlloc( "malloc" );
+		return __libc_malloc( nBytes );
+	}
+
+	void * calloc( size_t nCount, size_t nBytes )
+	{
+		checkAlloc( "calloc" );
+		return __libc_calloc( nCount, nBytes );
+	}
+
+	void * realloc( void * pMem, size_t nBytes )
+	{
+		checkAlloc( "realloc" );
+		return __libc_realloc( pMem, nBytes );
+	}
+
+	int posix_memalign( void ** ppMem, size_t nAlignment, size_t nBytes )
+	{
+		checkAlloc( "posix_memalign" );
+		*ppMem = __libc_memalign( nAlignment, nBytes );
+		return *ppMem != nullptr ? 0 : ENOMEM;
+	}
+
+	void * aligned_alloc( size_t nAlignment, size_t nBytes )
+	{
+		checkAlloc( "aligned_alloc" );
+		return __libc_memalign( nAlignment, nBytes );
+	}
+
+	void free( void * pMem )
+	{
+		if ( pMem != nullptr )
+			checkAlloc( "free" );
+		__libc_free( pMem );
+	}
+}
+#endif
+
+// The global operators, which go straight to the real allocator
+// so that a trapped new isn't counted twice
+void * operator new( std::size_t nBytes )
+{
+	checkAlloc( "operator new" );
+	void * pMem = LL_RAW_MALLOC( nBytes ? nBytes : 1 );
+	if ( pMem == nullptr )
+		throw std::bad_alloc();
+
+	return pMem;
+}
+
+void * operator new[]( std::size_t nBytes )
+{
+	return operator new( nBytes );
+}
+
+void * operator new( std::size_t nBytes, const std::nothrow_t& ) noexcept
+{
+	checkAlloc( "operator new" );
+	return LL_RAW_MALLOC( nBytes ? nBytes : 1 );
+}
+
+void * operator new[]( std::size_t nBytes, const std::nothrow_t& ) noexcept
+{
+	return operator new( nBytes, std::nothrow );
+}
+
+void operator delete( void * pMem ) noexcept
+{
+	if ( pMem != nullptr )
+		checkAlloc( "operator delete" );
+	LL_RAW_FREE( pMem );
+}
+
+void operator delete[]( void * pMem ) noexcept
+{
+	operator delete( pMem );
+}
+
+void operator delete( void * pMem, std::size_t ) noexcept
+{
+	operator delete( pMem );
+}
+
+void operator delete[]( void * pMem, std::size_t ) noexcept
+{
+	operator delete( pMem );
+}
+
+#else
+
+// Without the trap these are no-ops
+AllocTrap::Scope::Scope()
+{
+}
+
+AllocTrap::Scope::~Scope()
+{
+}
+
+bool AllocTrap::IsEnabled()
+{
+	return false;
+}
+
+void AllocTrap::SetAbort( bool )
+{
+}
+
+int AllocTrap::GetTrapCount()
+{
+	return 0;
+}
+
+#endif // LL_ALLOC_TRAP
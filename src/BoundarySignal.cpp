@@ -0,0 +1,107 @@
+#include "BoundarySignal.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <thread>
+
+#if defined( __linux__ )
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#elif defined( _WIN32 )
+#include <windows.h>
+#ifdef _MSC_VER
+#pragma comment( lib, "Synchronization.lib" )
+#endif
+#endif
+
+// The futex and WaitOnAddress both wait on the counter itself
+static_assert( sizeof( std::atomic<unsigned int> ) == sizeof( unsigned int ), "BoundarySignal waits on the atomic's storage" );
+
+namespace
+{
+	// Sleep while *pCount is uCount, for at most nTimeoutMS; this can
+	// return early, so the caller checks the count and time again
+	void waitOnCount( std::atomic<unsigned int> * pCount, unsigned int uCount, int nTimeoutMS )
+	{
+#if defined( __linux__ )
+		timespec ts;
+		ts.tv_sec = nTimeoutMS / 1000;
+		ts.tv_nsec = (nTimeoutMS % 1000) * 1000000L;
+		syscall( SYS_futex, reinterpret_cast<unsigned int *>( pCount ), FUTEX_WAIT_PRIVATE, uCount, nTimeoutMS < 0 ? nullptr : &ts, nullptr, 0 );
+#elif defined( _WIN32 )
+		WaitOnAddress( pCount, &uCount, sizeof( uCount ), nTimeoutMS < 0 ? INFINITE : (DWORD) nTimeoutMS );
+#else
+		(void) pCount;
+		(void) uCount;
+		if ( nTimeoutMS != 0 )
+			std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+#endif
+	}
+
+	void wakeAll( std::atomic<unsigned int> * pCount )
+	{
+#if defined( __linux__ )
+		syscall( SYS_futex, reinterpret_cast<unsigned int *>( pCount ), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0 );
+#elif defined( _WIN32 )
+		WakeByAddressAll( pCount );
+#else
+		(void) pCount;
+#endif
+	}
+}
+
+BoundarySignal::BoundarySignal() :
+	m_uCount( 0 ),
+	m_nWaiters( 0 )
+{
+}
+
+// Both sides go through sequentially consistent operations, so either
+// we see the waiter and wake it, or it sees the new count and doesn't
+// go to sleep (the futex checks the count before sleeping too)
+void BoundarySignal::Notify()
+{
+	m_uCount.fetch_add( 1 );
+	if ( m_nWaiters.load() > 0 )
+		wakeAll( &m_uCount );
+}
+
+unsigned int BoundarySignal::GetCount() const
+{
+	return m_uCount.load();
+}
+
+unsigned int BoundarySignal::Wait( unsigned int uCount, int nTimeoutMS )
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point tEnd = Clock::now() + std::chrono::milliseconds( std::max( 0, nTimeoutMS ) );
+
+	m_nWaiters.fetch_add( 1 );
+	for ( ;; )
+	{
+		const unsigned int uNow = m_uCount.load();
+		if ( uNow != uCount )
+		{
+			m_nWaiters.fetch_sub( 1 );
+			return uNow;
+		}
+
+		// Wake ups can be spurious, so wait out whatever time is left
+		int nLeftMS = -1;
+		if ( nTimeoutMS >= 0 )
+		{
+			const Clock::time_point tNow = Clock::now();
+			if ( tNow >= tEnd )
+				break;
+			nLeftMS = (int) std::chrono::duration_cast<std::chrono::milliseconds>( tEnd - tNow ).count() + 1;
+		}
+
+		waitOnCount( &m_uCount, uCount, nLeftMS );
+	}
+	m_nWaiters.fetch_sub( 1 );
+
+	return m_uCount.load();
+}
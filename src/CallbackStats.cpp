@@ -0,0 +1,152 @@
+#include "CallbackStats.h"
+
+#include <algorithm>
+
+using Histogram = CallbackStats::Histogram;
+
+Histogram::Histogram()
+{
+	Reset();
+}
+
+void Histogram::Add( unsigned int uValue )
+{
+	// The bucket is the number of bits needed to hold the value
+	int nBucket = 0;
+	for ( unsigned int u = uValue; u != 0; u >>= 1 )
+		nBucket++;
+	nBucket = std::min( nBucket, s_nBucketCount - 1 );
+
+	m_anBuckets[nBucket].fetch_add( 1, std::memory_order_relaxed );
+	m_nCount.fetch_add( 1, std::memory_order_relaxed );
+	m_uSum.fetch_add( uValue, std::memory_order_relaxed );
+
+	// We're the only writer, so this doesn't need to be a CAS
+	if ( uValue > m_uMax.load( std::memory_order_relaxed ) )
+		m_uMax.store( uValue, std::memory_order_relaxed );
+}
+
+void Histogram::Reset()
+{
+	for ( auto& nBucket : m_anBuckets )
+		nBucket.store( 0, std::memory_order_relaxed );
+	m_nCount.store( 0, std::memory_order_relaxed );
+	m_uSum.store( 0, std::memory_order_relaxed );
+	m_uMax.store( 0, std::memory_order_relaxed );
+}
+
+int Histogram::GetCount() const
+{
+	return m_nCount.load( std::memory_order_relaxed );
+}
+
+unsigned int Histogram::GetMax() const
+{
+	return m_uMax.load( std::memory_order_relaxed );
+}
+
+double Histogram::GetMean() const
+{
+	const int nCount = GetCount();
+	return nCount > 0 ? double( m_uSum.load( std::memory_order_relaxed ) ) / nCount : 0.;
+}
+
+double Histogram::GetPercentile( double dPercentile ) const
+{
+	const std::vector<int> vBuckets = GetBucketCounts();
+	int nTotal = 0;
+	for ( int nCount : vBuckets )
+		nTotal += nCount;
+	if ( nTotal == 0 )
+		return 0.;
+
+	// Walk up until we've seen enough values
+	const double dTarget = std::max( 1., nTotal * dPercentile / 100. );
+	int nSeen = 0;
+	for ( int i = 0; i < s_nBucketCount - 1; i++ )
+	{
+		nSeen += vBuckets[i];
+		if ( nSeen >= dTarget )
+			return i == 0 ? 0. : double( 1u << i ) - 1.;
+	}
+
+	// The last bucket has no upper edge
+	return double( GetMax() );
+}
+
+std::vector<int> Histogram::GetBucketCounts() const
+{
+	std::vector<int> vBuckets( s_nBucketCount );
+	for ( int i = 0; i < s_nBucketCount; i++ )
+		vBuckets[i] = m_anBuckets[i].load( std::memory_order_relaxed );
+
+	return vBuckets;
+}
+
+CallbackStats::CallbackStats() :
+	m_nLateCallbacks( 0 )
+{
+}
+
+void CallbackStats::RecordCallback( unsigned int uDurationUS, unsigned int uIntervalUS, int nFrames, float fBlockUS )
+{
+	m_hCallbackUS.Add( uDurationUS );
+	if ( uIntervalUS > 0 )
+		m_hIntervalUS.Add( uIntervalUS );
+	m_hBlockFrames.Add( (unsigned int) nFrames );
+
+	if ( uDurationUS > fBlockUS )
+		m_nLateCallbacks.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void CallbackStats::RecordBoundaryPost( unsigned int uDurationNS )
+{
+	m_hBoundaryNS.Add( uDurationNS );
+}
+
+void CallbackStats::Reset()
+{
+	m_hCallbackUS.Reset();
+	m_hIntervalUS.Reset();
+	m_hBlockFrames.Reset();
+	m_hBoundaryNS.Reset();
+	m_nLateCallbacks.store( 0, std::memory_order_relaxed );
+}
+
+std::map<std::string, double> CallbackStats::GetSummary() const
+{
+	std::map<std::string, double> mapSummary;
+	mapSummary["callbacks"] = m_hCallbackUS.GetCount();
+	mapSummary["late_callbacks"] = m_nLateCallbacks.load( std::memory_order_relaxed );
+	mapSummary["boundary_posts"] = m_hBoundaryNS.GetCount();
+
+	mapSummary["callback_us_mean"] = m_hCallbackUS.GetMean();
+	mapSummary["callback_us_p99"] = m_hCallbackUS.GetPercentile( 99. );
+	mapSummary["callback_us_max"] = m_hCallbackUS.GetMax();
+
+	mapSummary["interval_us_mean"] = m_hIntervalUS.GetMean();
+	mapSummary["interval_us_p99"] = m_hIntervalUS.GetPercentile( 99. );
+	mapSummary["interval_us_max"] = m_hIntervalUS.GetMax();
+
+	mapSummary["boundary_ns_mean"] = m_hBoundaryNS.GetMean();
+	mapSummary["boundary_ns_p99"] = m_hBoundaryNS.GetPercentile( 99. );
+	mapSummary["boundary_ns_max"] = m_hBoundaryNS.GetMax();
+
+	mapSummary["block_frames_max"] = m_hBlockFrames.GetMax();
+
+	return mapSummary;
+}
+
+std::vector<int> CallbackStats::GetHistogram( std::string histogramName ) const
+{
+	if ( histogramName == "callback_us" )
+		return m_hCallbackUS.GetBucketCounts();
+	if ( histogramName == "interval_us" )
+		return m_hIntervalUS.GetBucketCounts();
+	if ( histogramName == "block_frames" )
+		return m_hBlockFrames.GetBucketCounts();
+	if ( histogramName == "boundary_ns" )
+		return m_hBoundaryNS.GetBucketCounts();
+
+	return {};
+}
@@ -0,0 +1,323 @@
+#include "Clip.h"
+#include "ClipStream.h"
+#include "ClipCache.h"
+#include "ClipConform.h"
+#include "ClipStretch.h"
+#include "TempoCache.h"
+
+#include <SFML/Audio/InputSoundFile.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+Clip::Clip() :
+	m_uSlotClock( 0 )
+{
+	std::fill_n( m_anSlotBlock, s_nDecodeSlots, -1 );
+	std::fill_n( m_auSlotUse, s_nDecodeSlots, 0 );
+}
+
+Clip::Clip( Clip&& other ) :
+	m_pBuffer( std::move( other.m_pBuffer ) ),
+	m_pStream( std::move( other.m_pStream ) ),
+	m_pCompressed( std::move( other.m_pCompressed ) ),
+	m_DecodeSlots( std::move( other.m_DecodeSlots ) ),
+	m_uSlotClock( other.m_uSlotClock ),
+	m_strFileName( std::move( other.m_strFileName ) )
+{
+	std::copy_n( other.m_anSlotBlock, s_nDecodeSlots, m_anSlotBlock );
+	std::copy_n( other.m_auSlotUse, s_nDecodeSlots, m_auSlotUse );
+}
+
+Clip& Clip::operator=( Clip&& other )
+{
+	m_pBuffer = std::move( other.m_pBuffer );
+	m_pStream = std::move( other.m_pStream );
+	m_pCompressed = std::move( other.m_pCompressed );
+	m_DecodeSlots = std::move( other.m_DecodeSlots );
+	std::copy_n( other.m_anSlotBlock, s_nDecodeSlots, m_anSlotBlock );
+	std::copy_n( other.m_auSlotUse, s_nDecodeSlots, m_auSlotUse );
+	m_uSlotClock = other.m_uSlotClock;
+	m_strFileName = std::move( other.m_strFileName );
+
+	return *this;
+}
+
+// Out of line so unique_ptr can see ClipStream
+Clip::~Clip()
+{
+}
+
+bool Clip::LoadFromFile( std::string fileName )
+{
+	// Remember this in case we need to be conformed
+	m_strFileName = fileName;
+
+	// Peek at the header to see how long it is
+	sf::InputSoundFile file;
+	if ( file.openFromFile( fileName ) && file.getDuration().asSeconds() > s_fStreamSeconds )
+	{
+		std::unique_ptr<ClipStream> pStream( new ClipStream() );
+		if ( pStream->Open( fileName ) )
+		{
+			m_pStream = std::move( pStream );
+			return true;
+		}
+	}
+
+	// Decoded clips are shared through the cache
+	m_pBuffer = ClipCache::Acquire( fileName );
+	return m_pBuffer != nullptr;
+}
+
+bool Clip::LoadFromSamples( const sf::Int16 * pSamples, int nFrames, int nChannels, int nSampleRate )
+{
+	std::shared_ptr<ClipBuffer> pBuf = std::make_shared<ClipBuffer>();
+	if ( pBuf->LoadFromSamples( pSamples, nFrames, nChannels, nSampleRate ) == false )
+		return false;
+
+	m_pStream.reset();
+	m_pCompressed.reset();
+	m_pBuffer = pBuf;
+	m_strFileName.clear();
+	return true;
+}
+
+bool Clip::Conform( int nSampleRate, int nChannels )
+{
+	if ( IsLoaded() == false || nSampleRate <= 0 || nChannels <= 0 )
+		return false;
+
+	if ( GetSampleRate() == nSampleRate && GetChannelCount() == nChannels )
+		return true;
+
+	// Compressed clips get decompressed, conformed and compressed again
+	if ( m_pCompressed )
+	{
+		std::shared_ptr<ClipBuffer> pBuf = std::make_shared<ClipBuffer>();
+		if ( m_pCompressed->Decode( *pBuf ) == false )
+			return false;
+
+		const int nLossyBits = m_pCompressed->GetLossyBits();
+		m_pBuffer = pBuf;
+		m_pCompressed.reset();
+		return conformPCM( nSampleRate, nChannels ) && Compress( nLossyBits );
+	}
+
+	return conformPCM( nSampleRate, nChannels );
+}
+
+bool Clip::ConformTempo( float fSrcBPM, float fDstBPM )
+{
+	if ( IsLoaded() == false || fSrcBPM <= 0.f || fDstBPM <= 0.f )
+		return false;
+
+	if ( std::fabs( fSrcBPM / fDstBPM - 1.f ) < ClipStretch::s_fTempoTolerance )
+		return true;
+
+	const bool bCompressed = m_pCompressed != nullptr;
+	const int nLossyBits = bCompressed ? m_pCompressed->GetLossyBits() : 0;
+
+	// The stretched file can be loaded like any other, so
+	// it gets decoded or streamed depending on how long it is
+	if ( m_strFileName.empty() == false )
+	{
+		const std::string strStretched = TempoCache::Acquire( m_strFileName, fSrcBPM, fDstBPM );
+		if ( strStretched.empty() == false )
+		{
+			Clip stretched;
+			if ( stretched.LoadFromFile( strStretched ) )
+			{
+				*this = std::move( stretched );
+				return bCompressed ? Compress( nLossyBits ) : true;
+			}
+		}
+	}
+
+	// Otherwise we need our PCM, wherever it is
+	std::shared_ptr<const ClipBuffer> pSrc = m_pBuffer;
+	if ( m_pCompressed )
+	{
+		std::shared_ptr<ClipBuffer> pBuf = std::make_shared<ClipBuffer>();
+		if ( m_pCompressed->Decode( *pBuf ) == false )
+			return false;
+		pSrc = pBuf;
+	}
+	else if ( m_pStream )
+	{
+		pSrc = ClipCache::Acquire( m_strFileName );
+	}
+
+	std::shared_ptr<ClipBuffer> pBuf = std::make_shared<ClipBuffer>();
+	if ( pSrc == nullptr || ClipStretch::Stretch( *pSrc, *pBuf, ClipStretch::GetStretchedFrameCount( pSrc->GetFrameCount(), fSrcBPM, fDstBPM ) ) == false )
+		return false;
+
+	// This isn't the file's audio anymore, so it can't go through the cache
+	m_pStream.reset();
+	m_pCompressed.reset();
+	m_pBuffer = pBuf;
+	m_strFileName.clear();
+	return bCompressed ? Compress( nLossyBits ) : true;
+}
+
+bool Clip::conformPCM( int nSampleRate, int nChannels )
+{
+	// Files go through the cache, so anyone else
+	// conforming the same file shares the result
+	if ( m_strFileName.empty() == false )
+	{
+		std::shared_ptr<const ClipBuffer> pBuf = ClipCache::Acquire( m_strFileName, nSampleRate, nChannels );
+		if ( pBuf == nullptr )
+			return false;
+
+		m_pStream.reset();
+		m_pBuffer = pBuf;
+		return true;
+	}
+
+	std::shared_ptr<ClipBuffer> pBuf = std::make_shared<ClipBuffer>();
+	if ( ClipConform::Conform( *m_pBuffer, *pBuf, nSampleRate, nChannels ) == false )
+		return false;
+
+	m_pBuffer = pBuf;
+	return true;
+}
+
+bool Clip::Compress( int nLossyBits )
+{
+	if ( IsLoaded() == false )
+		return false;
+
+	if ( m_pCompressed )
+		return true;
+
+	// Files go through the cache, like conforming them does
+	std::shared_ptr<const CompressedClipBuffer> pCompressed;
+	if ( m_strFileName.empty() == false )
+	{
+		pCompressed = ClipCache::AcquireCompressed( m_strFileName, GetSampleRate(), GetChannelCount(), nLossyBits );
+	}
+	else
+	{
+		std::shared_ptr<CompressedClipBuffer> pNewCompressed = std::make_shared<CompressedClipBuffer>();
+		if ( pNewCompressed->Encode( *m_pBuffer, nLossyBits ) )
+			pCompressed = pNewCompressed;
+	}
+
+	if ( pCompressed == nullptr )
+		return false;
+
+	m_DecodeSlots.Resize( pCompressed->GetChannelCount(), s_nDecodeSlots * CompressedClipBuffer::s_nBlockFrames );
+	std::fill_n( m_anSlotBlock, s_nDecodeSlots, -1 );
+	std::fill_n( m_auSlotUse, s_nDecodeSlots, 0 );
+	m_uSlotClock = 0;
+
+	m_pStream.reset();
+	m_pBuffer.reset();
+	m_pCompressed = pCompressed;
+	return true;
+}
+
+int Clip::GetChannelCount() const
+{
+	if ( m_pStream )
+		return m_pStream->GetChannelCount();
+	if ( m_pCompressed )
+		return m_pCompressed->GetChannelCount();
+	return m_pBuffer ? m_pBuffer->GetChannelCount() : 0;
+}
+
+int Clip::GetSampleRate() const
+{
+	if ( m_pStream )
+		return m_pStream->GetSampleRate();
+	if ( m_pCompressed )
+		return m_pCompressed->GetSampleRate();
+	return m_pBuffer ? m_pBuffer->GetSampleRate() : 0;
+}
+
+int Clip::GetFrameCount() const
+{
+	if ( m_pStream )
+		return m_pStream->GetFrameCount();
+	if ( m_pCompressed )
+		return m_pCompressed->GetFrameCount();
+	return m_pBuffer ? m_pBuffer->GetFrameCount() : 0;
+}
+
+std::string Clip::GetFileName() const
+{
+	return m_strFileName;
+}
+
+bool Clip::IsLoaded() const
+{
+	return m_pBuffer != nullptr || m_pStream != nullptr || m_pCompressed != nullptr;
+}
+
+bool Clip::IsStreaming() const
+{
+	return m_pStream != nullptr;
+}
+
+bool Clip::IsCompressed() const
+{
+	return m_pCompressed != nullptr;
+}
+
+int Clip::GetUnderrunCount() const
+{
+	return m_pStream ? m_pStream->GetUnderrunCount() : 0;
+}
+
+int Clip::GetSpan( int nCursor, const sf::Int16 ** ppChannels )
+{
+	if ( m_pStream )
+		return m_pStream->GetSpan( nCursor, ppChannels );
+
+	if ( m_pCompressed )
+	{
+		const int nBlock = nCursor / CompressedClipBuffer::s_nBlockFrames;
+		const int nOffset = nCursor - nBlock * CompressedClipBuffer::s_nBlockFrames;
+		const int nSlotStart = getDecodeSlot( nBlock ) * CompressedClipBuffer::s_nBlockFrames;
+		for ( int c = 0; c < m_DecodeSlots.GetChannelCount(); c++ )
+			ppChannels[c] = m_DecodeSlots.GetChannel( c ) + nSlotStart + nOffset;
+
+		return m_pCompressed->GetBlockFrameCount( nBlock ) - nOffset;
+	}
+
+	for ( int c = 0; c < m_pBuffer->GetChannelCount(); c++ )
+		ppChannels[c] = m_pBuffer->GetChannel( c ) + nCursor;
+
+	return m_pBuffer->GetFrameCount() - nCursor;
+}
+
+int Clip::getDecodeSlot( int nBlock )
+{
+	m_uSlotClock++;
+
+	int nOldest = 0;
+	for ( int s = 0; s < s_nDecodeSlots; s++ )
+	{
+		if ( m_anSlotBlock[s] == nBlock )
+		{
+			m_auSlotUse[s] = m_uSlotClock;
+			return s;
+		}
+
+		if ( m_auSlotUse[s] < m_auSlotUse[nOldest] )
+			nOldest = s;
+	}
+
+	m_pCompressed->DecodeBlock( nBlock, m_DecodeSlots, nOldest * CompressedClipBuffer::s_nBlockFrames );
+
+	m_anSlotBlock[nOldest] = nBlock;
+	m_auSlotUse[nOldest] = m_uSlotClock;
+	return nOldest;
+}
+
+void Clip::Restart()
+{
+	if ( m_pStream )
+		m_pStream->Restart();
+}
@@ -0,0 +1,73 @@
+#include "ClipBuffer.h"
+
+#include <SFML/Audio/InputSoundFile.hpp>
+
+#include <vector>
+
+ClipBuffer::ClipBuffer() :
+	m_nSampleRate( 0 )
+{
+}
+
+bool ClipBuffer::LoadFromFile( std::string fileName )
+{
+	sf::InputSoundFile file;
+	if ( file.openFromFile( fileName ) == false )
+		return false;
+
+	const int nChannels = (int) file.getChannelCount();
+	if ( nChannels == 0 )
+		return false;
+
+	// An empty file would give us a clip we can never get through
+	const int nFrames = (int) (file.getSampleCount() / nChannels);
+	if ( nFrames <= 0 )
+		return false;
+
+	Resize( nChannels, nFrames );
+	m_nSampleRate = (int) file.getSampleRate();
+
+	// Read a chunk at a time so we never hold the whole file interleaved;
+	// if it comes up short the rest stays silent
+	const int nChunkFrames = 16384;
+	std::vector<sf::Int16> vChunk( size_t( nChunkFrames ) * nChannels );
+	for ( int nFrame = 0; nFrame < nFrames; )
+	{
+		const int nWant = std::min( nChunkFrames, nFrames - nFrame );
+		const int nRead = (int) (file.read( vChunk.data(), sf::Uint64( nWant ) * nChannels ) / nChannels);
+		if ( nRead <= 0 )
+			break;
+
+		Deinterleave( vChunk.data(), nFrame, nRead );
+		nFrame += nRead;
+	}
+
+	return true;
+}
+
+bool ClipBuffer::LoadFromSamples( const sf::Int16 * pSamples, int nFrames, int nChannels, int nSampleRate )
+{
+	if ( pSamples == nullptr || nFrames <= 0 || nChannels <= 0 || nSampleRate <= 0 )
+		return false;
+
+	Resize( nChannels, nFrames );
+	Deinterleave( pSamples, 0, nFrames );
+	m_nSampleRate = nSampleRate;
+
+	return true;
+}
+
+int ClipBuffer::GetSampleRate() const
+{
+	return m_nSampleRate;
+}
+
+void ClipBuffer::SetSampleRate( int nSampleRate )
+{
+	m_nSampleRate = nSampleRate;
+}
+
+size_t ClipBuffer::GetByteCount() const
+{
+	return size_t( GetChannelCount() ) * GetFrameCount() * sizeof( sf::Int16 );
+}
@@ -0,0 +1,283 @@
+#include "ClipCache.h"
+#include "ClipConform.h"
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace ClipCache
+{
+	// Everything here is guarded by s_muCache. Entries are weak so the
+	// cache never keeps a buffer alive by itself; expired ones get swept
+	// whenever we add something
+	static std::mutex s_muCache;
+	static std::map<std::string, std::weak_ptr<const ClipBuffer>> s_mapByPath;
+	static std::multimap<sf::Uint64, std::weak_ptr<const ClipBuffer>> s_mapByHash;
+	static std::map<std::tuple<std::string, int, int>, std::weak_ptr<const ClipBuffer>> s_mapConformed;
+	static std::map<std::tuple<std::string, int, int, int>, std::weak_ptr<const CompressedClipBuffer>> s_mapCompressed;
+	static bool s_bContentHashing = false;
+
+	// 64 bit FNV-1a over the format and samples
+	static sf::Uint64 hashBuffer( const ClipBuffer& sBuf )
+	{
+		sf::Uint64 uHash = 14695981039346656037ull;
+		auto hashBytes = [&uHash] ( const void * pData, size_t nBytes )
+		{
+			const unsigned char * pBytes = (const unsigned char *) pData;
+			for ( size_t i = 0; i < nBytes; i++ )
+				uHash = (uHash ^ pBytes[i]) * 1099511628211ull;
+		};
+
+		const int anFormat[3] = { sBuf.GetChannelCount(), sBuf.GetSampleRate(), sBuf.GetFrameCount() };
+		hashBytes( anFormat, sizeof( anFormat ) );
+		for ( int c = 0; c < sBuf.GetChannelCount(); c++ )
+			hashBytes( sBuf.GetChannel( c ), size_t( sBuf.GetFrameCount() ) * sizeof( sf::Int16 ) );
+
+		return uHash;
+	}
+
+	static bool sameAudio( const ClipBuffer& a, const ClipBuffer& b )
+	{
+		if ( a.GetChannelCount() != b.GetChannelCount()
+			|| a.GetSampleRate() != b.GetSampleRate()
+			|| a.GetFrameCount() != b.GetFrameCount() )
+			return false;
+
+		for ( int c = 0; c < a.GetChannelCount(); c++ )
+			if ( std::memcmp( a.GetChannel( c ), b.GetChannel( c ), size_t( a.GetFrameCount() ) * sizeof( sf::Int16 ) ) != 0 )
+				return false;
+
+		return true;
+	}
+
+	template <typename M>
+	static void sweep( M& map )
+	{
+		for ( auto it = map.begin(); it != map.end(); )
+			it = it->second.expired() ? map.erase( it ) : std::next( it );
+	}
+
+	std::string GetCanonicalPath( std::string fileName )
+	{
+#ifdef _WIN32
+		char szPath[_MAX_PATH];
+		if ( _fullpath( szPath, fileName.c_str(), _MAX_PATH ) )
+			return szPath;
+#else
+		char szPath[PATH_MAX];
+		if ( realpath( fileName.c_str(), szPath ) )
+			return szPath;
+#endif
+		return fileName;
+	}
+
+	std::shared_ptr<const ClipBuffer> Acquire( std::string fileName )
+	{
+		const std::string strPath = GetCanonicalPath( fileName );
+
+		// See if we've already got it
+		bool bContentHashing = false;
+		{
+			std::lock_guard<std::mutex> lg( s_muCache );
+			auto it = s_mapByPath.find( strPath );
+			if ( it != s_mapByPath.end() )
+			{
+				if ( auto pBuf = it->second.lock() )
+					return pBuf;
+			}
+
+			bContentHashing = s_bContentHashing;
+		}
+
+		// Decode without holding the lock, so other threads can load too
+		std::shared_ptr<ClipBuffer> pNewBuf = std::make_shared<ClipBuffer>();
+		if ( pNewBuf->LoadFromFile( fileName ) == false )
+			return nullptr;
+
+		const sf::Uint64 uHash = bContentHashing ? hashBuffer( *pNewBuf ) : 0;
+
+		std::lock_guard<std::mutex> lg( s_muCache );
+		sweep( s_mapByPath );
+		sweep( s_mapByHash );
+
+		// Someone else may have loaded the same path while we were decoding
+		auto it = s_mapByPath.find( strPath );
+		if ( it != s_mapByPath.end() )
+		{
+			if ( auto pBuf = it->second.lock() )
+				return pBuf;
+		}
+
+		// If the audio's identical to something we have, share that instead
+		std::shared_ptr<const ClipBuffer> pBuf = pNewBuf;
+		if ( bContentHashing )
+		{
+			auto range = s_mapByHash.equal_range( uHash );
+			for ( auto itHash = range.first; itHash != range.second; ++itHash )
+			{
+				auto pExisting = itHash->second.lock();
+				if ( pExisting && sameAudio( *pExisting, *pNewBuf ) )
+				{
+					pBuf = pExisting;
+					break;
+				}
+			}
+
+			if ( pBuf == pNewBuf )
+				s_mapByHash.emplace( uHash, pBuf );
+		}
+
+		s_mapByPath[strPath] = pBuf;
+
+		return pBuf;
+	}
+
+	std::shared_ptr<const ClipBuffer> Acquire( std::string fileName, int nSampleRate, int nChannels )
+	{
+		// Hang on to the original while we conform it, so that if other
+		// tracks want it in other formats it only gets decoded once
+		std::shared_ptr<const ClipBuffer> pSrc = Acquire( fileName );
+		if ( pSrc == nullptr || (pSrc->GetSampleRate() == nSampleRate && pSrc->GetChannelCount() == nChannels) )
+			return pSrc;
+
+		const auto key = std::make_tuple( GetCanonicalPath( fileName ), nSampleRate, nChannels );
+		{
+			std::lock_guard<std::mutex> lg( s_muCache );
+			auto it = s_mapConformed.find( key );
+			if ( it != s_mapConformed.end() )
+			{
+				if ( auto pBuf = it->second.lock() )
+					return pBuf;
+			}
+		}
+
+		std::shared_ptr<ClipBuffer> pNewBuf = std::make_shared<ClipBuffer>();
+		if ( ClipConform::Conform( *pSrc, *pNewBuf, nSampleRate, nChannels ) == false )
+			return nullptr;
+
+		std::lock_guard<std::mutex> lg( s_muCache );
+		sweep( s_mapConformed );
+
+		// Same as above, someone may have beaten us to it
+		auto it = s_mapConformed.find( key );
+		if ( it != s_mapConformed.end() )
+		{
+			if ( auto pBuf = it->second.lock() )
+				return pBuf;
+		}
+
+		s_mapConformed[key] = pNewBuf;
+
+		return pNewBuf;
+	}
+
+	std::shared_ptr<const CompressedClipBuffer> AcquireCompressed( std::string fileName, int nSampleRate, int nChannels, int nLossyBits )
+	{
+		const auto key = std::make_tuple( GetCanonicalPath( fileName ), nSampleRate, nChannels, nLossyBits );
+		{
+			std::lock_guard<std::mutex> lg( s_muCache );
+			auto it = s_mapCompressed.find( key );
+			if ( it != s_mapCompressed.end() )
+			{
+				if ( auto pCompressed = it->second.lock() )
+					return pCompressed;
+			}
+		}
+
+		std::shared_ptr<const ClipBuffer> pSrc = Acquire( fileName, nSampleRate, nChannels );
+		std::shared_ptr<CompressedClipBuffer> pNewCompressed = std::make_shared<CompressedClipBuffer>();
+		if ( pSrc == nullptr || pNewCompressed->Encode( *pSrc, nLossyBits ) == false )
+			return nullptr;
+
+		std::lock_guard<std::mutex> lg( s_muCache );
+		sweep( s_mapCompressed );
+
+		// Same as above, someone may have beaten us to it
+		auto it = s_mapCompressed.find( key );
+		if ( it != s_mapCompressed.end() )
+		{
+			if ( auto pCompressed = it->second.lock() )
+				return pCompressed;
+		}
+
+		s_mapCompressed[key] = pNewCompressed;
+
+		return pNewCompressed;
+	}
+
+	void SetContentHashing( bool bContentHashing )
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		if ( bContentHashing == s_bContentHashing )
+			return;
+
+		s_bContentHashing = bContentHashing;
+		if ( bContentHashing == false )
+		{
+			s_mapByHash.clear();
+			return;
+		}
+
+		// Hash whatever was loaded before this was turned on
+		std::map<const ClipBuffer *, std::shared_ptr<const ClipBuffer>> mapBuffers;
+		for ( auto& it : s_mapByPath )
+			if ( auto pBuf = it.second.lock() )
+				mapBuffers[pBuf.get()] = pBuf;
+
+		for ( auto& it : mapBuffers )
+			s_mapByHash.emplace( hashBuffer( *it.second ), it.second );
+	}
+
+	bool GetContentHashing()
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		return s_bContentHashing;
+	}
+
+	int GetEntryCount()
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		sweep( s_mapByPath );
+		sweep( s_mapConformed );
+		sweep( s_mapCompressed );
+
+		// Paths can share buffers, so count distinct ones
+		std::map<const ClipBuffer *, int> mapBuffers;
+		for ( auto& it : s_mapByPath )
+			if ( auto pBuf = it.second.lock() )
+				mapBuffers[pBuf.get()]++;
+		for ( auto& it : s_mapConformed )
+			if ( auto pBuf = it.second.lock() )
+				mapBuffers[pBuf.get()]++;
+
+		return (int) (mapBuffers.size() + s_mapCompressed.size());
+	}
+
+	size_t GetByteCount()
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		sweep( s_mapByPath );
+		sweep( s_mapConformed );
+		sweep( s_mapCompressed );
+
+		std::map<const ClipBuffer *, size_t> mapBuffers;
+		for ( auto& it : s_mapByPath )
+			if ( auto pBuf = it.second.lock() )
+				mapBuffers[pBuf.get()] = pBuf->GetByteCount();
+		for ( auto& it : s_mapConformed )
+			if ( auto pBuf = it.second.lock() )
+				mapBuffers[pBuf.get()] = pBuf->GetByteCount();
+
+		size_t nBytes = 0;
+		for ( auto& it : mapBuffers )
+			nBytes += it.second;
+		for ( auto& it : s_mapCompressed )
+			if ( auto pCompressed = it.second.lock() )
+				nBytes += pCompressed->GetByteCount();
+
+		return nBytes;
+	}
+}
@@ -0,0 +1,213 @@
+#include "ClipConform.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace ClipConform
+{
+	// The filter spans this many zero crossings either side of its
+	// centre, at whichever of the two rates is lower; with the Kaiser
+	// window below that's about 90 dB of stopband, and a transition
+	// band of about 9% of the lower Nyquist rate. The cutoff sits in
+	// the middle of that, so the stopband starts at Nyquist
+	static const int s_nZeroCrossings = 32;
+	static const double s_dKaiserBeta = 9.;
+	static const double s_dCutoff = 0.91;
+
+	// Rate ratios with more phases than this (i.e. 44100 -> 44101)
+	// interpolate between the two nearest phases
+	static const int s_nMaxPhases = 256;
+
+	static constexpr double s_dPi = 3.14159265358979323846;
+
+	static int gcd( int a, int b )
+	{
+		while ( b != 0 )
+		{
+			const int r = a % b;
+			a = b;
+			b = r;
+		}
+
+		return a;
+	}
+
+	// Zeroth order modified Bessel function of the first kind
+	static double besselI0( double x )
+	{
+		double dSum = 1., dTerm = 1.;
+		for ( int k = 1; k < 64 && dTerm > 1e-12 * dSum; k++ )
+		{
+			const double dHalf = x / (2. * k);
+			dTerm *= dHalf * dHalf;
+			dSum += dTerm;
+		}
+
+		return dSum;
+	}
+
+	// ClipConform::Resampler
+	// Converts one channel of float samples between two rates. If the
+	// reduced ratio is nUp / nDown, output frame n sits nDown / nUp of
+	// a source frame after output frame n - 1, so its fractional
+	// position cycles through nUp phases; there's a filter for each
+	class Resampler
+	{
+	public:
+		Resampler( int nSrcRate, int nDstRate )
+		{
+			const int nGCD = gcd( nSrcRate, nDstRate );
+			m_nUp = nDstRate / nGCD;
+			m_nDown = nSrcRate / nGCD;
+			m_nPhases = std::min( m_nUp, s_nMaxPhases );
+
+			// When downsampling the filter has to get wider (in source
+			// samples) as the cutoff drops; pad it to a multiple of 8
+			// for MixKernels::DotProduct
+			const double dScale = std::min( 1., double( nDstRate ) / nSrcRate );
+			const double dHalfWidth = s_nZeroCrossings / dScale;
+			m_nTaps = ((int) std::ceil( 2. * dHalfWidth ) + 7) & ~7;
+
+			// Tap k of phase p is at source offset k - (nTaps / 2 - 1) - p / nPhases
+			// from where the output lands. There's one more phase than we need
+			// so that interpolating between phases can always look at p + 1
+			const double dCutoff = 0.5 * s_dCutoff * dScale;
+			const double dWindowNorm = besselI0( s_dKaiserBeta );
+			m_vFilters.resize( (m_nPhases + 1) * m_nTaps );
+			for ( int p = 0; p <= m_nPhases; p++ )
+			{
+				float * pFilter = &m_vFilters[p * m_nTaps];
+				double dSum = 0.;
+				for ( int k = 0; k < m_nTaps; k++ )
+				{
+					const double dOffset = k - (m_nTaps / 2 - 1) - double( p ) / m_nPhases;
+					const double dX = 2. * dCutoff * dOffset;
+					const double dSinc = dX == 0. ? 1. : std::sin( s_dPi * dX ) / (s_dPi * dX);
+					const double dW = dOffset / (m_nTaps / 2);
+					const double dWindow = std::fabs( dW ) < 1. ? besselI0( s_dKaiserBeta * std::sqrt( 1. - dW * dW ) ) / dWindowNorm : 0.;
+
+					pFilter[k] = (float) (dSinc * dWindow);
+					dSum += pFilter[k];
+				}
+
+				// Unity gain at DC for every phase
+				for ( int k = 0; k < m_nTaps; k++ )
+					pFilter[k] = (float) (pFilter[k] / dSum);
+			}
+		}
+
+		// How many frames nFrames source frames turn into
+		sf::Int64 GetOutputFrames( int nFrames ) const
+		{
+			return (sf::Int64( nFrames ) * m_nUp + m_nDown / 2) / m_nDown;
+		}
+
+		// Resample a loop of nFrames samples into pDst
+		void Process( const float * pSrc, int nFrames, float * pDst, int nDstFrames ) const
+		{
+			// Wrap the loop around both ends so the filter never runs off
+			std::vector<float> vPadded( nFrames + 2 * m_nTaps );
+			for ( int i = 0; i < (int) vPadded.size(); i++ )
+				vPadded[i] = pSrc[((i - m_nTaps) % nFrames + nFrames) % nFrames];
+
+			for ( int n = 0; n < nDstFrames; n++ )
+			{
+				// Where this lands in the source, as a whole frame and phase
+				const sf::Int64 nPos = sf::Int64( n ) * m_nDown;
+				const int nFrame = (int) (nPos / m_nUp);
+				const int nPhaseNum = (int) (nPos % m_nUp) * m_nPhases;
+				const int nPhase = nPhaseNum / m_nUp;
+				const float fFrac = float( nPhaseNum % m_nUp ) / m_nUp;
+
+				const float * pIn = &vPadded[nFrame - (m_nTaps / 2 - 1) + m_nTaps];
+				float fOut = MixKernels::DotProduct( pIn, &m_vFilters[nPhase * m_nTaps], m_nTaps );
+				if ( fFrac > 0.f )
+				{
+					const float fNext = MixKernels::DotProduct( pIn, &m_vFilters[(nPhase + 1) * m_nTaps], m_nTaps );
+					fOut += fFrac * (fNext - fOut);
+				}
+
+				pDst[n] = fOut;
+			}
+		}
+
+	private:
+		int m_nUp;
+		int m_nDown;
+		int m_nPhases;
+		int m_nTaps;
+		std::vector<float> m_vFilters;
+	};
+
+	bool Conform( const ClipBuffer& src, ClipBuffer& dst, int nSampleRate, int nChannels )
+	{
+		const int nFrames = src.GetFrameCount();
+		const int nSrcChannels = src.GetChannelCount();
+		if ( nFrames <= 0 || nSrcChannels <= 0 || nChannels <= 0 || src.GetSampleRate() <= 0 || nSampleRate <= 0 )
+			return false;
+
+		// Mix down to mono by averaging, and up from mono by copying; anything
+		// else keeps the channels the two have in common (repeating them if
+		// there are more output channels.) When we're copying mono up there's
+		// only one plane to resample, which the output channels share
+		const int nPlanes = nSrcChannels == 1 ? 1 : nChannels;
+		std::vector<std::vector<float>> vPlanes( nPlanes, std::vector<float>( nFrames ) );
+		for ( int c = 0; c < nPlanes; c++ )
+		{
+			float * pPlane = vPlanes[c].data();
+			if ( nChannels == 1 )
+			{
+				const float fScale = 1.f / nSrcChannels;
+				for ( int s = 0; s < nSrcChannels; s++ )
+				{
+					const sf::Int16 * pSrc = src.GetChannel( s );
+					for ( int i = 0; i < nFrames; i++ )
+						pPlane[i] += pSrc[i];
+				}
+				for ( int i = 0; i < nFrames; i++ )
+					pPlane[i] *= fScale;
+			}
+			else
+			{
+				const sf::Int16 * pSrc = src.GetChannel( c % nSrcChannels );
+				for ( int i = 0; i < nFrames; i++ )
+					pPlane[i] = pSrc[i];
+			}
+		}
+
+		// Resample each plane if the rates differ
+		int nDstFrames = nFrames;
+		if ( src.GetSampleRate() != nSampleRate )
+		{
+			Resampler resampler( src.GetSampleRate(), nSampleRate );
+			nDstFrames = (int) resampler.GetOutputFrames( nFrames );
+			for ( auto& vPlane : vPlanes )
+			{
+				std::vector<float> vResampled( nDstFrames );
+				resampler.Process( vPlane.data(), nFrames, vResampled.data(), nDstFrames );
+				vPlane.swap( vResampled );
+			}
+		}
+
+		if ( nDstFrames <= 0 )
+			return false;
+
+		// Round and saturate, since the filter can overshoot
+		dst.Resize( nChannels, nDstFrames );
+		dst.SetSampleRate( nSampleRate );
+		for ( int c = 0; c < nChannels; c++ )
+		{
+			const float * pPlane = vPlanes[c % nPlanes].data();
+			sf::Int16 * pDst = dst.GetChannel( c );
+			for ( int i = 0; i < nDstFrames; i++ )
+			{
+				const float fVal = std::max( -32768.f, std::min( 32767.f, pPlane[i] ) );
+				pDst[i] = (sf::Int16) std::lrint( fVal );
+			}
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,64 @@
+#include "ClipLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace ClipLoader
+{
+	// 0 means use every hardware thread
+	static std::atomic<int> s_nThreadCount( 0 );
+
+	int GetThreadCount()
+	{
+		const int nThreads = s_nThreadCount.load();
+		if ( nThreads > 0 )
+			return nThreads;
+
+		return std::max( 1, (int) std::thread::hardware_concurrency() );
+	}
+
+	void SetThreadCount( int nThreads )
+	{
+		s_nThreadCount.store( std::max( 0, nThreads ) );
+	}
+
+	void ParallelFor( int nJobs, std::function<void( int )> fnJob )
+	{
+		if ( nJobs <= 0 )
+			return;
+
+		// Each worker grabs the next job until they're gone
+		std::atomic<int> nNextJob( 0 );
+		auto fnWorker = [&nNextJob, nJobs, &fnJob] ()
+		{
+			for ( int nJob = nNextJob++; nJob < nJobs; nJob = nNextJob++ )
+				fnJob( nJob );
+		};
+
+		std::vector<std::thread> vWorkers;
+		const int nThreads = std::min( nJobs, GetThreadCount() );
+		for ( int i = 1; i < nThreads; i++ )
+			vWorkers.emplace_back( fnWorker );
+
+		fnWorker();
+
+		for ( auto& worker : vWorkers )
+			worker.join();
+	}
+
+	std::vector<Clip> LoadClips( const std::vector<std::string>& vFileNames, std::vector<std::string>& vFailures )
+	{
+		std::vector<Clip> vClips( vFileNames.size() );
+		ParallelFor( (int) vFileNames.size(), [&vClips, &vFileNames] ( int nJob )
+		{
+			vClips[nJob].LoadFromFile( vFileNames[nJob] );
+		} );
+
+		for ( size_t i = 0; i < vClips.size(); i++ )
+			if ( vClips[i].IsLoaded() == false )
+				vFailures.push_back( vFileNames[i] );
+
+		return vClips;
+	}
+}
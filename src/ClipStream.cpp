@@ -0,0 +1,255 @@
+#include "ClipStream.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+// The I/O thread, shared by every stream in the process. It's started
+// when the first stream is opened and polls all of them, sleeping
+// briefly whenever none of them had any room to fill
+namespace
+{
+	class Streamer
+	{
+	public:
+		Streamer() :
+			m_bRunning( true ),
+			m_Thread( &Streamer::run, this )
+		{
+		}
+
+		~Streamer()
+		{
+			m_bRunning.store( false );
+			m_Thread.join();
+		}
+
+		void Add( ClipStream * pStream )
+		{
+			std::lock_guard<std::mutex> lg( m_muStreams );
+			m_vStreams.push_back( pStream );
+		}
+
+		void Remove( ClipStream * pStream )
+		{
+			std::lock_guard<std::mutex> lg( m_muStreams );
+			m_vStreams.erase( std::remove( m_vStreams.begin(), m_vStreams.end(), pStream ), m_vStreams.end() );
+		}
+
+	private:
+		void run()
+		{
+			while ( m_bRunning.load() )
+			{
+				bool bWork = false;
+				{
+					std::lock_guard<std::mutex> lg( m_muStreams );
+					for ( ClipStream * pStream : m_vStreams )
+						bWork |= pStream->Service();
+				}
+
+				if ( bWork == false )
+					std::this_thread::sleep_for( std::chrono::milliseconds( 2 ) );
+			}
+		}
+
+		// The mutex is only ever taken by this thread and whoever is
+		// opening or destroying streams, never the audio thread
+		std::mutex m_muStreams;
+		std::vector<ClipStream *> m_vStreams;
+		std::atomic<bool> m_bRunning;
+		std::thread m_Thread;
+	};
+
+	Streamer& getStreamer()
+	{
+		static Streamer s_Streamer;
+		return s_Streamer;
+	}
+}
+
+ClipStream::ClipStream() :
+	m_nChannels( 0 ),
+	m_nSampleRate( 0 ),
+	m_nFrames( 0 ),
+	m_nHeadFrames( 0 ),
+	m_nRingFrames( 0 ),
+	m_uEpoch( 0 ),
+	m_nLoopTail( 0 ),
+	m_nReadTail( 0 ),
+	m_uReadState( 0 ),
+	m_nUnderruns( 0 ),
+	m_uDecodeEpoch( 0 ),
+	m_nDecodeTail( 0 ),
+	m_nFilePos( 0 ),
+	m_uWriteState( 0 )
+{
+}
+
+ClipStream::~ClipStream()
+{
+	// Once this returns the I/O thread is done with us
+	if ( m_nRingFrames > 0 )
+		getStreamer().Remove( this );
+}
+
+bool ClipStream::Open( std::string fileName )
+{
+	if ( m_nRingFrames > 0 || m_File.openFromFile( fileName ) == false )
+		return false;
+
+	m_nChannels = (int) m_File.getChannelCount();
+	m_nSampleRate = (int) m_File.getSampleRate();
+	m_nFrames = (int) (m_File.getSampleCount() / std::max( 1, m_nChannels ));
+
+	// If the whole thing fits in the head there's no point streaming it
+	m_nHeadFrames = (int) (s_fHeadSeconds * m_nSampleRate);
+	if ( m_nChannels == 0 || m_nFrames <= m_nHeadFrames )
+		return false;
+
+	// Decode the head; if the file comes up short the rest stays silent
+	m_Head.Resize( m_nChannels, m_nHeadFrames );
+	std::vector<sf::Int16> vHead( size_t( m_nHeadFrames ) * m_nChannels );
+	const int nHeadRead = (int) (m_File.read( vHead.data(), vHead.size() ) / m_nChannels);
+	m_Head.Deinterleave( vHead.data(), 0, nHeadRead );
+	m_nFilePos = m_nHeadFrames;
+
+	// The ring is a power of two so positions can be masked
+	m_nRingFrames = 1;
+	while ( m_nRingFrames < s_fRingSeconds * m_nSampleRate )
+		m_nRingFrames <<= 1;
+	m_Ring.Resize( m_nChannels, m_nRingFrames );
+	m_Silence.Resize( m_nChannels, s_nSilenceFrames );
+	m_vDecode.resize( size_t( s_nDecodeChunkFrames ) * m_nChannels );
+
+	// Start filling the ring right away
+	getStreamer().Add( this );
+
+	return true;
+}
+
+int ClipStream::GetChannelCount() const
+{
+	return m_nChannels;
+}
+
+int ClipStream::GetSampleRate() const
+{
+	return m_nSampleRate;
+}
+
+int ClipStream::GetFrameCount() const
+{
+	return m_nFrames;
+}
+
+int ClipStream::GetUnderrunCount() const
+{
+	return m_nUnderruns.load( std::memory_order_relaxed );
+}
+
+/*static*/ sf::Uint64 ClipStream::packState( unsigned uEpoch, sf::Int64 nTail )
+{
+	return (sf::Uint64( uEpoch & 0xFFFF ) << s_nEpochShift) | (sf::Uint64( nTail ) & s_uTailMask);
+}
+
+int ClipStream::GetSpan( int nCursor, const sf::Int16 ** ppChannels )
+{
+	// The head is always there
+	if ( nCursor < m_nHeadFrames )
+	{
+		for ( int c = 0; c < m_nChannels; c++ )
+			ppChannels[c] = m_Head.GetChannel( c ) + nCursor;
+		return m_nHeadFrames - nCursor;
+	}
+
+	// Where this is in the (endlessly looping) tail; the cursor only
+	// goes backwards when it wraps, so that's when we start a new pass
+	const int nTailFrames = m_nFrames - m_nHeadFrames;
+	sf::Int64 nTail = m_nLoopTail + (nCursor - m_nHeadFrames);
+	if ( nTail < m_nReadTail )
+	{
+		m_nLoopTail += nTailFrames;
+		nTail += nTailFrames;
+	}
+	const int nToClipEnd = m_nFrames - nCursor;
+
+	// Everything before this is done with, so let the I/O thread reuse it
+	if ( nTail != m_nReadTail )
+	{
+		m_nReadTail = nTail;
+		m_uReadState.store( packState( m_uEpoch, m_nReadTail ), std::memory_order_release );
+	}
+
+	// Make sure the I/O thread has caught up with this epoch and position
+	const sf::Uint64 uWriteState = m_uWriteState.load( std::memory_order_acquire );
+	const sf::Int64 nWriteTail = (sf::Int64) (uWriteState & s_uTailMask);
+	if ( (uWriteState >> s_nEpochShift) != (m_uEpoch & 0xFFFF) || nWriteTail <= nTail )
+	{
+		m_nUnderruns.fetch_add( 1, std::memory_order_relaxed );
+		for ( int c = 0; c < m_nChannels; c++ )
+			ppChannels[c] = m_Silence.GetChannel( c );
+		return std::min( m_Silence.GetFrameCount(), nToClipEnd );
+	}
+
+	// Read up to whatever's been written, the end of the ring, or the end of the clip
+	const int nRingPos = (int) (nTail & (m_nRingFrames - 1));
+	for ( int c = 0; c < m_nChannels; c++ )
+		ppChannels[c] = m_Ring.GetChannel( c ) + nRingPos;
+	return (int) std::min<sf::Int64>( { nWriteTail - nTail, m_nRingFrames - nRingPos, nToClipEnd } );
+}
+
+void ClipStream::Restart()
+{
+	// If we never got past the head there's nothing to refill
+	if ( m_nReadTail == 0 )
+		return;
+
+	m_uEpoch++;
+	m_nLoopTail = 0;
+	m_nReadTail = 0;
+	m_uReadState.store( packState( m_uEpoch, 0 ), std::memory_order_release );
+}
+
+bool ClipStream::Service()
+{
+	const sf::Uint64 uReadState = m_uReadState.load( std::memory_order_acquire );
+	const unsigned uEpoch = (unsigned) (uReadState >> s_nEpochShift);
+	const sf::Int64 nReadTail = (sf::Int64) (uReadState & s_uTailMask);
+
+	// The clip was relaunched, so go back to the end of the head
+	if ( uEpoch != m_uDecodeEpoch )
+	{
+		m_uDecodeEpoch = uEpoch;
+		m_nDecodeTail = 0;
+		m_nFilePos = m_nHeadFrames;
+		m_File.seek( sf::Uint64( m_nFilePos ) * m_nChannels );
+		m_uWriteState.store( packState( uEpoch, 0 ), std::memory_order_release );
+	}
+
+	// Don't bother with tiny reads
+	const int nFree = m_nRingFrames - (int) (m_nDecodeTail - nReadTail);
+	if ( nFree < s_nDecodeChunkFrames )
+		return false;
+
+	// Decode as much as fits before the end of the ring or the file
+	const int nRingPos = (int) (m_nDecodeTail & (m_nRingFrames - 1));
+	const int nFrames = std::min( { s_nDecodeChunkFrames, m_nRingFrames - nRingPos, m_nFrames - m_nFilePos } );
+	const int nRead = (int) (m_File.read( m_vDecode.data(), sf::Uint64( nFrames ) * m_nChannels ) / m_nChannels);
+	std::fill( m_vDecode.begin() + size_t( nRead ) * m_nChannels, m_vDecode.begin() + size_t( nFrames ) * m_nChannels, 0 );
+	m_Ring.Deinterleave( m_vDecode.data(), nRingPos, nFrames );
+
+	// Loop back around to the end of the head
+	m_nDecodeTail += nFrames;
+	m_nFilePos += nFrames;
+	if ( m_nFilePos >= m_nFrames )
+	{
+		m_nFilePos = m_nHeadFrames;
+		m_File.seek( sf::Uint64( m_nFilePos ) * m_nChannels );
+	}
+
+	m_uWriteState.store( packState( m_uDecodeEpoch, m_nDecodeTail ), std::memory_order_release );
+
+	return true;
+}
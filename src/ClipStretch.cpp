@@ -0,0 +1,209 @@
+#include "ClipStretch.h"
+#include "MixKernels.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace ClipStretch
+{
+	// Grains are this long, and overlap by half; the search for where
+	// to take each one from looks this far either side of its spot
+	static const float s_fGrainMS = 40.f;
+	static const float s_fSearchMS = 12.f;
+
+	static constexpr double s_dPi = 3.14159265358979323846;
+
+	static int wrap( sf::Int64 nPos, int nFrames )
+	{
+		return (int) (((nPos % nFrames) + nFrames) % nFrames);
+	}
+
+	bool Stretch( const ClipBuffer& src, ClipBuffer& dst, int nDstFrames )
+	{
+		const int nFrames = src.GetFrameCount();
+		const int nChannels = src.GetChannelCount();
+		if ( nFrames <= 0 || nChannels <= 0 || nDstFrames <= 0 || src.GetSampleRate() <= 0 )
+			return false;
+
+		dst.Resize( nChannels, nDstFrames );
+		dst.SetSampleRate( src.GetSampleRate() );
+		if ( nDstFrames == nFrames )
+		{
+			for ( int c = 0; c < nChannels; c++ )
+				std::copy_n( src.GetChannel( c ), nFrames, dst.GetChannel( c ) );
+			return true;
+		}
+
+		// Grains are a multiple of 16 frames long, so the half we compare
+		// is a multiple of 8 for MixKernels::DotProduct; very short clips
+		// get shorter grains, so there are always at least two
+		int nGrain = (int) (src.GetSampleRate() * s_fGrainMS / 1000.f) & ~15;
+		nGrain = std::min( nGrain, (std::min( nFrames, nDstFrames ) / 2) & ~15 );
+		if ( nGrain < 16 )
+			return false;
+
+		const int nHalf = nGrain / 2;
+		const int nSearch = std::min( (int) (src.GetSampleRate() * s_fSearchMS / 1000.f), nFrames / 4 );
+
+		// The mono mix we search, wrapped around both ends far enough
+		// that any grain we could look at can be read without wrapping
+		const int nPad = nGrain + nSearch + 1;
+		std::vector<float> vMono( nFrames + 2 * nPad );
+		for ( int i = 0; i < (int) vMono.size(); i++ )
+		{
+			const int nSrc = wrap( i - nPad, nFrames );
+			float fSum = 0.f;
+			for ( int c = 0; c < nChannels; c++ )
+				fSum += src.GetChannel( c )[nSrc];
+			vMono[i] = fSum / nChannels;
+		}
+		const float * pMono = vMono.data() + nPad;
+
+		// Place grains every half grain or so, spread evenly over the
+		// output so the last one overlaps the first; nGrains of them
+		// start at nDstFrames * g / nGrains. Each is taken from its
+		// nominal spot in the source, give or take nSearch frames
+		const int nGrains = std::max( 1, (int) std::lround( double( nDstFrames ) / nHalf ) );
+		std::vector<int> vGrainSrc( nGrains );
+		int nPrevDst = 0;
+		for ( int g = 0; g < nGrains; g++ )
+		{
+			const int nDst = (int) (sf::Int64( nDstFrames ) * g / nGrains);
+			const int nNominal = (int) (sf::Int64( nDst ) * nFrames / nDstFrames);
+			if ( g == 0 )
+			{
+				vGrainSrc[g] = nNominal;
+				continue;
+			}
+
+			// What would've followed the last grain if we'd kept
+			// going, which the new one should look as much like as it
+			// can where they overlap (normalized by the new one's level,
+			// so loud bits don't win just for being loud)
+			const float * pNatural = pMono + wrap( vGrainSrc[g - 1] + nDst - nPrevDst, nFrames );
+			const float * pFirst = pMono + nNominal - nSearch;
+			double dEnergy = MixKernels::DotProduct( pFirst, pFirst, nHalf );
+
+			int nBest = 0;
+			double dBestScore = -1e300;
+			for ( int d = -nSearch; d <= nSearch; d++ )
+			{
+				const float * pCandidate = pMono + nNominal + d;
+				const double dScore = MixKernels::DotProduct( pNatural, pCandidate, nHalf ) / std::sqrt( std::max( dEnergy, 1. ) );
+				if ( dScore > dBestScore )
+				{
+					dBestScore = dScore;
+					nBest = d;
+				}
+
+				dEnergy += double( pCandidate[nHalf] ) * pCandidate[nHalf] - double( pCandidate[0] ) * pCandidate[0];
+			}
+
+			vGrainSrc[g] = wrap( nNominal + nBest, nFrames );
+			nPrevDst = nDst;
+		}
+
+		// Overlap add the grains, then divide out the sum of the windows;
+		// spacing isn't always exactly half a grain, so it's not always 1
+		std::vector<float> vWindow( nGrain );
+		for ( int i = 0; i < nGrain; i++ )
+			vWindow[i] = (float) (0.5 - 0.5 * std::cos( 2. * s_dPi * i / nGrain ));
+
+		std::vector<float> vWeight( nDstFrames, 0.f );
+		for ( int g = 0; g < nGrains; g++ )
+		{
+			const int nDst = (int) (sf::Int64( nDstFrames ) * g / nGrains);
+			for ( int i = 0; i < nGrain; i++ )
+				vWeight[(nDst + i) % nDstFrames] += vWindow[i];
+		}
+
+		std::vector<float> vOut( nDstFrames );
+		for ( int c = 0; c < nChannels; c++ )
+		{
+			const sf::Int16 * pSrc = src.GetChannel( c );
+			std::fill( vOut.begin(), vOut.end(), 0.f );
+			for ( int g = 0; g < nGrains; g++ )
+			{
+				const int nDst = (int) (sf::Int64( nDstFrames ) * g / nGrains);
+				for ( int i = 0; i < nGrain; i++ )
+					vOut[(nDst + i) % nDstFrames] += vWindow[i] * pSrc[(vGrainSrc[g] + i) % nFrames];
+			}
+
+			// Round and saturate, as ClipConform does
+			sf::Int16 * pDst = dst.GetChannel( c );
+			for ( int i = 0; i < nDstFrames; i++ )
+			{
+				const float fSample = vWeight[i] > 1e-3f ? vOut[i] / vWeight[i] : 0.f;
+				pDst[i] = (sf::Int16) std::lrint( std::max( -32768.f, std::min( 32767.f, fSample ) ) );
+			}
+		}
+
+		return true;
+	}
+
+	// Looks for a number right before "bpm" (give or take a space,
+	// dash or underscore) in the file's name, not counting folders
+	static float parseTempo( std::string fileName )
+	{
+		const size_t nSlash = fileName.find_last_of( "/\\" );
+		std::string strName = nSlash == std::string::npos ? fileName : fileName.substr( nSlash + 1 );
+		std::transform( strName.begin(), strName.end(), strName.begin(), [] ( char ch ) { return (char) std::tolower( (unsigned char) ch ); } );
+
+		for ( size_t nBPM = strName.find( "bpm" ); nBPM != std::string::npos; nBPM = strName.find( "bpm", nBPM + 1 ) )
+		{
+			size_t nEnd = nBPM;
+			if ( nEnd > 0 && (strName[nEnd - 1] == ' ' || strName[nEnd - 1] == '-' || strName[nEnd - 1] == '_') )
+				nEnd--;
+
+			size_t nStart = nEnd;
+			while ( nStart > 0 && (std::isdigit( (unsigned char) strName[nStart - 1] ) || strName[nStart - 1] == '.') )
+				nStart--;
+
+			const float fBPM = nStart < nEnd ? (float) std::atof( strName.substr( nStart, nEnd - nStart ).c_str() ) : 0.f;
+			if ( fBPM > 0.f )
+				return fBPM;
+		}
+
+		return 0.f;
+	}
+
+	float GetSourceTempo( std::string fileName, int nFrames, int nSampleRate, float fBPM, int nBeatsPerBar )
+	{
+		const float fNamedBPM = parseTempo( fileName );
+		if ( fNamedBPM > 0.f )
+			return fNamedBPM;
+
+		if ( nFrames <= 0 || nSampleRate <= 0 || fBPM <= 0.f || nBeatsPerBar <= 0 )
+			return fBPM;
+
+		// Compare lengths as ratios, so that being twice
+		// as long is as far off as being half as long
+		const double dSeconds = double( nFrames ) / nSampleRate;
+		const double dBarSeconds = 60. * nBeatsPerBar / fBPM;
+		const int nMaxBars = (int) std::ceil( dSeconds / dBarSeconds ) + 1;
+		double dBestBars = 1., dBestError = 1e300;
+		for ( int n = -2; n <= nMaxBars; n++ )
+		{
+			const double dBars = n <= 0 ? std::ldexp( 1., n - 1 ) : double( n );
+			const double dError = std::fabs( std::log( dSeconds / (dBars * dBarSeconds) ) );
+			if ( dError < dBestError )
+			{
+				dBestError = dError;
+				dBestBars = dBars;
+			}
+		}
+
+		return (float) (60. * nBeatsPerBar * dBestBars / dSeconds);
+	}
+
+	int GetStretchedFrameCount( int nFrames, float fSrcBPM, float fDstBPM )
+	{
+		if ( fSrcBPM <= 0.f || fDstBPM <= 0.f )
+			return nFrames;
+
+		return (int) std::lround( double( nFrames ) * fSrcBPM / fDstBPM );
+	}
+}
@@ -0,0 +1,260 @@
+#include "CompressedClipBuffer.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+// Each block channel is laid out as
+//
+//   order (1 byte), then order warmup samples (2 bytes each,
+//   little endian), then for every group of up to s_nGroupFrames
+//   residuals a width (1 byte) and the residuals packed LSB first
+//   at that many bits each, padded out to a byte
+//
+// Residuals are zigzagged so small negative ones stay small. The
+// largest an order 2 residual can be needs 18 bits. Lossy buffers
+// store residuals divided by 2^bits, rounded, and predict from the
+// samples the decoder will end up with, so the error never builds
+// up past half a step.
+
+namespace
+{
+	int predict( int nOrder, int nPrev1, int nPrev2 )
+	{
+		return nOrder == 0 ? 0 : nOrder == 1 ? nPrev1 : 2 * nPrev1 - nPrev2;
+	}
+
+	int clampSample( int nSample )
+	{
+		return std::max( -32768, std::min( 32767, nSample ) );
+	}
+
+	sf::Uint32 zigzag( int nResidual )
+	{
+		return ((sf::Uint32) nResidual << 1) ^ (sf::Uint32) (nResidual >> 31);
+	}
+
+	int unzigzag( sf::Uint32 uValue )
+	{
+		return (int) (uValue >> 1) ^ -(int) (uValue & 1);
+	}
+
+	// The predictor with the smallest residuals over the block,
+	// judged from sample 2 on so every order is looked at over
+	// the same samples (the warmup's stored as is anyway)
+	int choosePredictor( const sf::Int16 * pSrc, int nFrames )
+	{
+		if ( nFrames < 3 )
+			return 0;
+
+		long long anCost[3] = { 0, 0, 0 };
+		for ( int i = 2; i < nFrames; i++ )
+			for ( int o = 0; o < 3; o++ )
+				anCost[o] += std::abs( pSrc[i] - predict( o, pSrc[i - 1], pSrc[i - 2] ) );
+
+		return (int) (std::min_element( anCost, anCost + 3 ) - anCost);
+	}
+
+	void encodeChannel( const sf::Int16 * pSrc, int nFrames, int nLossyBits, std::vector<unsigned char>& vData )
+	{
+		const int nOrder = choosePredictor( pSrc, nFrames );
+		vData.push_back( (unsigned char) nOrder );
+
+		// The history is what the decoder will have, not the source
+		int nPrev1 = 0, nPrev2 = 0;
+		for ( int i = 0; i < nOrder; i++ )
+		{
+			const sf::Uint16 uSample = (sf::Uint16) pSrc[i];
+			vData.push_back( (unsigned char) (uSample & 0xFF) );
+			vData.push_back( (unsigned char) (uSample >> 8) );
+			nPrev2 = nPrev1;
+			nPrev1 = pSrc[i];
+		}
+
+		const int nStep = 1 << nLossyBits;
+		sf::Uint32 auGroup[CompressedClipBuffer::s_nGroupFrames];
+		for ( int nStart = nOrder; nStart < nFrames; nStart += CompressedClipBuffer::s_nGroupFrames )
+		{
+			const int nCount = std::min( (int) CompressedClipBuffer::s_nGroupFrames, nFrames - nStart );
+			sf::Uint32 uMax = 0;
+			for ( int i = 0; i < nCount; i++ )
+			{
+				// Round to the nearest step (>> floors, even if it's negative)
+				const int nPredicted = predict( nOrder, nPrev1, nPrev2 );
+				const int nResidual = (pSrc[nStart + i] - nPredicted + nStep / 2) >> nLossyBits;
+				auGroup[i] = zigzag( nResidual );
+				uMax = std::max( uMax, auGroup[i] );
+
+				nPrev2 = nPrev1;
+				nPrev1 = clampSample( nPredicted + nResidual * nStep );
+			}
+
+			int nWidth = 0;
+			while ( (uMax >> nWidth) != 0 )
+				nWidth++;
+			vData.push_back( (unsigned char) nWidth );
+
+			sf::Uint64 uBits = 0;
+			int nBits = 0;
+			for ( int i = 0; i < nCount; i++ )
+			{
+				uBits |= (sf::Uint64) auGroup[i] << nBits;
+				for ( nBits += nWidth; nBits >= 8; nBits -= 8 )
+				{
+					vData.push_back( (unsigned char) (uBits & 0xFF) );
+					uBits >>= 8;
+				}
+			}
+
+			if ( nBits > 0 )
+				vData.push_back( (unsigned char) (uBits & 0xFF) );
+		}
+	}
+
+	void decodeChannel( const unsigned char * pData, int nFrames, int nLossyBits, sf::Int16 * pDst )
+	{
+		const int nOrder = *pData++;
+		for ( int i = 0; i < nOrder; i++, pData += 2 )
+			pDst[i] = (sf::Int16) (sf::Uint16) (pData[0] | (pData[1] << 8));
+
+		// Unpack every residual, then undo the prediction in one pass
+		int anResidual[CompressedClipBuffer::s_nBlockFrames];
+		for ( int nStart = nOrder; nStart < nFrames; nStart += CompressedClipBuffer::s_nGroupFrames )
+		{
+			const int nCount = std::min( (int) CompressedClipBuffer::s_nGroupFrames, nFrames - nStart );
+			const int nWidth = *pData++;
+			const sf::Uint64 uMask = ((sf::Uint64) 1 << nWidth) - 1;
+
+			// Every residual is read with one unaligned 64 bit load,
+			// so none of them depend on the one before; Encode pads
+			// the end of the data so these never read past it
+			for ( int i = 0; i < nCount; i++ )
+			{
+				const int nBit = i * nWidth;
+				sf::Uint64 uBits;
+				std::memcpy( &uBits, pData + (nBit >> 3), sizeof( uBits ) );
+				anResidual[nStart + i] = unzigzag( (sf::Uint32) ((uBits >> (nBit & 7)) & uMask) );
+			}
+			pData += (nCount * nWidth + 7) >> 3;
+		}
+
+		// The history's kept in registers rather than read back from
+		// pDst, which would stall on every store. Clamping only does
+		// anything if we're lossy, but it's cheaper than branching
+		const int nStep = 1 << nLossyBits;
+		int nPrev1 = nOrder > 0 ? pDst[nOrder - 1] : 0;
+		int nPrev2 = nOrder > 1 ? pDst[nOrder - 2] : 0;
+		switch ( nOrder )
+		{
+			case 0:
+				for ( int i = 0; i < nFrames; i++ )
+					pDst[i] = (sf::Int16) clampSample( anResidual[i] * nStep );
+				break;
+			case 1:
+				for ( int i = 1; i < nFrames; i++ )
+					pDst[i] = (sf::Int16) (nPrev1 = clampSample( nPrev1 + anResidual[i] * nStep ));
+				break;
+			default:
+				for ( int i = 2; i < nFrames; i++ )
+				{
+					const int nSample = clampSample( 2 * nPrev1 - nPrev2 + anResidual[i] * nStep );
+					pDst[i] = (sf::Int16) nSample;
+					nPrev2 = nPrev1;
+					nPrev1 = nSample;
+				}
+				break;
+		}
+	}
+}
+
+CompressedClipBuffer::CompressedClipBuffer() :
+	m_nChannels( 0 ),
+	m_nSampleRate( 0 ),
+	m_nFrames( 0 ),
+	m_nLossyBits( 0 )
+{
+}
+
+bool CompressedClipBuffer::Encode( const ClipBuffer& buffer, int nLossyBits )
+{
+	if ( buffer.IsEmpty() || buffer.GetFrameCount() == 0 || nLossyBits < 0 || nLossyBits > s_nMaxLossyBits )
+		return false;
+
+	m_nChannels = buffer.GetChannelCount();
+	m_nSampleRate = buffer.GetSampleRate();
+	m_nFrames = buffer.GetFrameCount();
+	m_nLossyBits = nLossyBits;
+
+	m_vOffsets.resize( size_t( GetBlockCount() ) * m_nChannels );
+	m_vData.clear();
+	for ( int b = 0; b < GetBlockCount(); b++ )
+	{
+		for ( int c = 0; c < m_nChannels; c++ )
+		{
+			m_vOffsets[size_t( b ) * m_nChannels + c] = m_vData.size();
+			encodeChannel( buffer.GetChannel( c ) + b * s_nBlockFrames, GetBlockFrameCount( b ), m_nLossyBits, m_vData );
+		}
+	}
+
+	m_vData.insert( m_vData.end(), sizeof( sf::Uint64 ), 0 );
+	m_vData.shrink_to_fit();
+	return true;
+}
+
+bool CompressedClipBuffer::Decode( ClipBuffer& buffer ) const
+{
+	if ( m_nFrames == 0 )
+		return false;
+
+	buffer.Resize( m_nChannels, m_nFrames );
+	buffer.SetSampleRate( m_nSampleRate );
+
+	for ( int b = 0; b < GetBlockCount(); b++ )
+		DecodeBlock( b, buffer, b * s_nBlockFrames );
+
+	return true;
+}
+
+int CompressedClipBuffer::DecodeBlock( int nBlock, PlanarBuffer<sf::Int16>& buffer, int nFrame ) const
+{
+	const int nFrames = GetBlockFrameCount( nBlock );
+	for ( int c = 0; c < m_nChannels; c++ )
+		decodeChannel( &m_vData[m_vOffsets[size_t( nBlock ) * m_nChannels + c]], nFrames, m_nLossyBits, buffer.GetChannel( c ) + nFrame );
+
+	return nFrames;
+}
+
+int CompressedClipBuffer::GetChannelCount() const
+{
+	return m_nChannels;
+}
+
+int CompressedClipBuffer::GetSampleRate() const
+{
+	return m_nSampleRate;
+}
+
+int CompressedClipBuffer::GetFrameCount() const
+{
+	return m_nFrames;
+}
+
+int CompressedClipBuffer::GetLossyBits() const
+{
+	return m_nLossyBits;
+}
+
+int CompressedClipBuffer::GetBlockCount() const
+{
+	return (m_nFrames + s_nBlockFrames - 1) / s_nBlockFrames;
+}
+
+int CompressedClipBuffer::GetBlockFrameCount( int nBlock ) const
+{
+	return std::min( (int) s_nBlockFrames, m_nFrames - nBlock * s_nBlockFrames );
+}
+
+size_t CompressedClipBuffer::GetByteCount() const
+{
+	return m_vData.size() + m_vOffsets.size() * sizeof( size_t );
+}
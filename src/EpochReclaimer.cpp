@@ -0,0 +1,50 @@
+#include "EpochReclaimer.h"
+
+#include <algorithm>
+
+EpochReclaimer::EpochReclaimer() :
+	m_uEpoch( 0 )
+{
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+	Clear();
+}
+
+// These are sequentially consistent, as is the store that publishes
+// a new version; that's what guarantees that if the control thread
+// sees an even epoch, the audio thread's next load sees the new version
+void EpochReclaimer::Enter()
+{
+	m_uEpoch.fetch_add( 1 );
+}
+
+void EpochReclaimer::Exit()
+{
+	m_uEpoch.fetch_add( 1 );
+}
+
+void EpochReclaimer::Retire( std::shared_ptr<const void> pRetired )
+{
+	if ( pRetired )
+		m_vRetired.push_back( { std::move( pRetired ), m_uEpoch.load() } );
+	Reclaim();
+}
+
+int EpochReclaimer::Reclaim()
+{
+	const unsigned int uEpoch = m_uEpoch.load();
+	auto itEnd = std::remove_if( m_vRetired.begin(), m_vRetired.end(), [uEpoch] ( const Retired& retired )
+	{
+		return (retired.uEpoch & 1) == 0 || retired.uEpoch != uEpoch;
+	} );
+	m_vRetired.erase( itEnd, m_vRetired.end() );
+
+	return (int) m_vRetired.size();
+}
+
+void EpochReclaimer::Clear()
+{
+	m_vRetired.clear();
+}
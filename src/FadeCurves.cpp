@@ -0,0 +1,75 @@
+#include "FadeCurves.h"
+
+namespace FadeCurves
+{
+	// Entries span t = [0, 1] inclusive
+	static constexpr int s_nTableSize = 1025;
+	static constexpr double s_dHalfPi = 1.57079632679489661923;
+
+	// Taylor series for sin, good to well under a float ULP on
+	// [0, pi/2] (the only range we need) and usable at compile time
+	static constexpr double constSin( double x )
+	{
+		double dTerm = x;
+		double dSum = x;
+		for ( int n = 1; n < 12; n++ )
+		{
+			dTerm *= -x * x / ((2 * n) * (2 * n + 1));
+			dSum += dTerm;
+		}
+
+		return dSum;
+	}
+
+	struct Table
+	{
+		float afGain[s_nTableSize];
+
+		constexpr Table( EShape eShape ) :
+			afGain{}
+		{
+			for ( int i = 0; i < s_nTableSize; i++ )
+			{
+				const double t = double( i ) / (s_nTableSize - 1);
+				afGain[i] = float( eShape == EShape::EqualPower ? constSin( t * s_dHalfPi ) : t );
+			}
+		}
+	};
+
+	static constexpr Table s_LinearTable( EShape::Linear );
+	static constexpr Table s_EqualPowerTable( EShape::EqualPower );
+
+	// Make sure these really are built by the compiler
+	static_assert( s_EqualPowerTable.afGain[0] == 0.f && s_EqualPowerTable.afGain[s_nTableSize - 1] == 1.f, "Bad equal power fade table" );
+	static_assert( s_LinearTable.afGain[(s_nTableSize - 1) / 2] == 0.5f, "Bad linear fade table" );
+
+	float FadeGain( EShape eShape, float t )
+	{
+		const float * pTable = eShape == EShape::EqualPower ? s_EqualPowerTable.afGain : s_LinearTable.afGain;
+
+		// Clamp, then interpolate between the two nearest entries
+		t = t < 0.f ? 0.f : (t > 1.f ? 1.f : t);
+		const float fPos = t * (s_nTableSize - 1);
+		const int nIdx = fPos < s_nTableSize - 1 ? (int) fPos : s_nTableSize - 2;
+		const float fFrac = fPos - nIdx;
+
+		return pTable[nIdx] + fFrac * (pTable[nIdx + 1] - pTable[nIdx]);
+	}
+
+	void FillFadeIn( float * pFadeIn, int nFrames, EShape eShape )
+	{
+		for ( int i = 0; i < nFrames; i++ )
+			pFadeIn[i] = FadeGain( eShape, float( i ) / nFrames );
+	}
+
+	void FillFadeOut( float * pFadeOut, int nStart, int nCount, int nFrames, EShape eShape )
+	{
+		for ( int i = 0; i < nCount; i++ )
+			pFadeOut[i] = FadeGain( eShape, 1.f - float( nStart + i ) / nFrames );
+	}
+
+	const char * GetShapeName( EShape eShape )
+	{
+		return eShape == EShape::EqualPower ? "EqualPower" : "Linear";
+	}
+}
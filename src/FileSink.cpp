@@ -0,0 +1,51 @@
+#include "FileSink.h"
+
+FileSink::FileSink( std::string fileName, bool bClocked ) :
+	NullSink( bClocked ),
+	m_FileName( fileName ),
+	m_nChannels( 0 ),
+	m_nSampleRate( 0 )
+{
+}
+
+// Our thread writes to the file, so it has to stop before the file goes
+FileSink::~FileSink()
+{
+	Stop();
+}
+
+// If we were paused, carry on with the same file
+bool FileSink::Start( Source * pSource, int nChannels, int nSampleRate )
+{
+	if ( m_pFile && nChannels == m_nChannels && nSampleRate == m_nSampleRate )
+		return NullSink::Start( pSource, nChannels, nSampleRate );
+
+	Stop();
+	m_pFile.reset( new sf::OutputSoundFile() );
+	if ( m_pFile->openFromFile( m_FileName, nSampleRate, nChannels ) == false || NullSink::Start( pSource, nChannels, nSampleRate ) == false )
+	{
+		m_pFile.reset();
+		return false;
+	}
+
+	m_nChannels = nChannels;
+	m_nSampleRate = nSampleRate;
+	return true;
+}
+
+void FileSink::Stop()
+{
+	NullSink::Stop();
+	m_pFile.reset();
+}
+
+// Stop pulling, but keep the file
+void FileSink::Pause()
+{
+	NullSink::Stop();
+}
+
+void FileSink::onBlock( const Chunk& chunk )
+{
+	m_pFile->write( chunk.pSamples, chunk.nSamples );
+}
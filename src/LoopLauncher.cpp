@@ -1,18 +1,48 @@
 #include "LoopLauncher.h"
 
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
 
-#include <pyliason.h>
+#include "MixKernels.h"
+#include "ClipLoader.h"
+#include "ClipStretch.h"
+#include "AllocTrap.h"
+#include "SFMLSink.h"
+#include "NullSink.h"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
 
 using Track = LoopLauncher::Track;
 
 // Default constructor sets all pending tracks null
 Track::Track() :
-	m_nFadeSamples( 0 ),
-	m_nSampleCount( 0 ),
-	m_pPendingTrack( nullptr ),
-	m_pPendingClip( nullptr )
+	m_nFadeFrames( 0 ),
+	m_eFadeShape( FadeCurves::EShape::EqualPower ),
+	m_nNextFadeFrames( 0 ),
+	m_eNextFadeShape( FadeCurves::EShape::EqualPower ),
+	m_nTailFrames( 0 ),
+	m_nFrameCount( 0 ),
+	m_nHandle( -1 ),
+	m_fGain( 1.f ),
+	m_afPanGain{ { 1.f, 1.f } },
+	m_nRampStartFrame( 0 ),
+	m_pClipTable( new ClipTable{ {}, 1, 1 } ),
+	m_pNextClips( m_pClipTable.get() ),
+	m_pPlayClips( m_pClipTable.get() ),
+	m_pReclaimer( nullptr ),
+	m_nStagedClip( -1 ),
+	m_nActiveClip( -1 ),
+	m_nPendingClip( -1 ),
+	m_eLaunchMode( ELaunchMode::Grid ),
+	m_nActiveCursor( 0 ),
+	m_nFadePos( 0 )
 {
+	// Start at unity gain, with nothing to ramp
+	m_afCurGain.fill( 1.f );
+	m_afRampStart.fill( 1.f / 32768.f );
+	m_afRampStep.fill( 0.f );
 }
 
 // Construct with a list of clips (audio files)
@@ -24,436 +54,1856 @@ Track::Track( std::list<std::string> liFileNames ) :
 		AddClip( file );
 }
 
-// && constructor / operator=
-Track::Track( Track&& other ) :
-	m_nFadeSamples( other.m_nFadeSamples ),
-	m_nSampleCount( other.m_nSampleCount ),
-	m_pPendingTrack( other.m_pPendingTrack ),
-	m_pPendingClip( other.m_pPendingClip ),
-	m_mapClips( std::move( other.m_mapClips ) )
+// The active assumption is that these are the same for all clips
+// These are all for the control thread, and read the latest table
+int Track::GetChannelCount() const
 {
+	return m_pClipTable->nChannels;
 }
 
-Track& Track::operator=( Track&& other )
+int Track::GetSampleRate() const
 {
-	m_nFadeSamples = other.m_nFadeSamples;
-	m_nSampleCount = other.m_nSampleCount;
-	m_pPendingTrack = other.m_pPendingTrack;
-	m_pPendingClip = other.m_pPendingClip;
-	m_mapClips = std::move( other.m_mapClips );
+	return m_pClipTable->nSampleRate;
+}
 
-	return *this;
+int Track::GetFrameCount() const
+{
+	return m_nFrameCount > 0 ? m_nFrameCount : 1;
 }
 
-// The active assumption is that these are the same for all clips
-int Track::GetChannelCount() const
+int Track::GetClipCount() const
 {
-	return m_mapClips.empty() ? 1 : m_mapClips.begin()->second.getChannelCount();
+	return (int)m_pClipTable->vClips.size();
 }
 
-int Track::GetSampleRate() const
+bool Track::IsClipLoaded( int nClip ) const
 {
-	return m_mapClips.empty() ? 1 : m_mapClips.begin()->second.getSampleRate();
+	return nClip >= 0 && nClip < GetClipCount() && m_pClipTable->vClips[nClip] != nullptr;
 }
 
-int Track::GetSampleCount() const
+bool Track::IsClipStreaming( int nClip ) const
 {
-	return m_mapClips.empty() ? 1 : (int)m_mapClips.begin()->second.getSampleCount();
+	return IsClipLoaded( nClip ) && m_pClipTable->vClips[nClip]->IsStreaming();
 }
 
-// Use SFML to load audio files
-bool Track::AddClip( std::string fileName )
+int Track::GetUnderrunCount() const
 {
-	sf::SoundBuffer sBuf;
-	if ( sBuf.loadFromFile( fileName ) )
-	{
-		// Initialize this if it hasn't been set
-		// (again assumming that all files have same sample count)
-		if ( m_nSampleCount == 0 )
-			m_nSampleCount = (int)sBuf.getSampleCount();
+	int nUnderruns = 0;
+	for ( auto& pClip : m_pClipTable->vClips )
+		if ( pClip )
+			nUnderruns += pClip->GetUnderrunCount();
 
-		// Set the fade duration - this is a work in progress
-		if ( m_nFadeSamples == 0 )
-		{
-			const float mS = 5.f;
-			const float samplesPerMS = sBuf.getSampleRate() / 1000.f;
-			m_nFadeSamples = (int) (mS * samplesPerMS);
-		}
+	return nUnderruns;
+}
 
-		// Move the sound buffer into our map
-		m_mapClips[fileName] = std::move( sBuf );
+// Use SFML to load audio files; long ones get streamed
+int Track::AddClip( std::string fileName )
+{
+	// Don't load the same file twice
+	auto it = m_mapClipHandles.find( fileName );
+	if ( it != m_mapClipHandles.end() )
+		return it->second;
 
-		return true;
-	}
+	Clip clip;
+	if ( clip.LoadFromFile( fileName ) == false )
+		return -1;
 
-	return false;
+	// Match whatever we've already got
+	if ( m_mapClipHandles.empty() == false && clip.Conform( GetSampleRate(), GetChannelCount() ) == false )
+		return -1;
+
+	return AddClip( fileName, std::move( clip ) );
 }
 
-// This is invoked via LoopLauncher::postPendingTracks
-// which gets called from the audio thread when it detects
-// an imminent loop boundary
-bool Track::SetPendingTrack( std::string trackName )
+// Take ownership of a clip that's already been loaded
+int Track::AddClip( std::string fileName, Clip clip )
 {
-	auto it = m_mapClips.find( trackName );
-	if ( m_mapClips.end() != it )
+	auto it = m_mapClipHandles.find( fileName );
+	if ( it != m_mapClipHandles.end() )
+		return it->second;
+
+	// Removed clips keep their slot, so this counts them; a clip with
+	// no frames would never advance the cursor, so it's no good either
+	if ( clip.IsLoaded() == false || clip.GetFrameCount() <= 0 || GetClipCount() >= s_nMaxClipsPerTrack )
+		return -1;
+
+	// Initialize this if it hasn't been set
+	// (again assumming that all files have same frame count)
+	if ( m_nFrameCount == 0 )
+		m_nFrameCount = clip.GetFrameCount();
+
+	// Publish a new table with the clip on the end, its index is the
+	// handle; the first clip we get decides our format
+	std::shared_ptr<ClipTable> pClipTable = std::make_shared<ClipTable>( *m_pClipTable );
+	if ( m_mapClipHandles.empty() )
 	{
-		m_pPendingClip = &it->second;
+		pClipTable->nChannels = clip.GetChannelCount();
+		pClipTable->nSampleRate = clip.GetSampleRate();
+	}
 
-		return true;
+	const int nClip = (int)pClipTable->vClips.size();
+	pClipTable->vClips.push_back( std::make_shared<Clip>( std::move( clip ) ) );
+	m_mapClipHandles[fileName] = nClip;
+
+	// Set up the default fade once we know the format, reserving
+	// room for the longest so SetFade never has to allocate
+	if ( m_nFadeFrames == 0 )
+	{
+		const float framesPerMS = pClipTable->nSampleRate / 1000.f;
+		m_nFadeFrames = m_nNextFadeFrames = (int) (s_fDefaultFadeMS * framesPerMS);
+		m_vFadeIn.reserve( getMaxFadeFrames( pClipTable->nSampleRate ) );
+		buildFadeCurves();
 	}
-	else
-		m_pPendingClip = nullptr;
 
-	return false;
+	publishClips( std::move( pClipTable ) );
+
+	return nClip;
 }
 
-// This gets called from the audio thread and fills the mix buffer
-// with nSamplesDesired samples, finding the current sample position within
-// the track audio given the global sample pos (nCurSamplePos)
-bool Track::GetAudio( sf::Int16 * pMixBuffer, int nSamplesDesired, int nCurSamplePos )
+// The clip's slot stays, empty, so other clips keep their indices
+bool Track::RemoveClip( std::string clipName )
 {
-	// Volume... a work in progress
-	const float vol_1 = 1.f / 1.25;
+	auto it = m_mapClipHandles.find( clipName );
+	if ( it == m_mapClipHandles.end() )
+		return false;
 
-	// Pointer check
-	if ( pMixBuffer == nullptr )
+	std::shared_ptr<ClipTable> pClipTable = std::make_shared<ClipTable>( *m_pClipTable );
+	pClipTable->vClips[it->second] = nullptr;
+	m_mapClipHandles.erase( it );
+	publishClips( std::move( pClipTable ) );
+
+	return true;
+}
+
+// Swap in a new table, and retire the one it replaces
+void Track::publishClips( std::shared_ptr<const ClipTable> pClipTable )
+{
+	std::shared_ptr<const ClipTable> pRetired = std::move( m_pClipTable );
+	m_pClipTable = std::move( pClipTable );
+	m_pNextClips.store( m_pClipTable.get() );
+
+	// If there's no audio thread, we're it
+	if ( m_pReclaimer )
+		m_pReclaimer->Retire( std::move( pRetired ) );
+	else
+		m_pPlayClips = m_pClipTable.get();
+}
+
+// Called on the loader pool, see LoopLauncher::conformTracks
+bool Track::ConformClip( int nClip, int nSampleRate, int nChannels )
+{
+	if ( IsClipLoaded( nClip ) == false )
+		return false;
+
+	return m_pClipTable->vClips[nClip]->Conform( nSampleRate, nChannels );
+}
+
+// Also called on the loader pool, after ConformClip
+bool Track::CompressClip( int nClip, int nLossyBits )
+{
+	if ( IsClipLoaded( nClip ) == false )
 		return false;
 
-	// If the active clip is null but the pending clip is not
-	// assign the active clip to the pending clip, 
-	// leaving pending clip as is
-	if ( m_pPendingTrack == nullptr && m_pPendingClip != nullptr )
-		m_pPendingTrack = m_pPendingClip;
-	// If both are null,  return false (silence)
-	else if ( m_pPendingTrack == nullptr )
+	return m_pClipTable->vClips[nClip]->Compress( nLossyBits );
+}
+
+// And this one before ConformClip
+bool Track::ConformClipTempo( int nClip, float fBPM, int nBeatsPerBar )
+{
+	if ( IsClipLoaded( nClip ) == false )
 		return false;
 
-	// Create a ref to the active clip
-	sf::SoundBuffer& soundBuf = *m_pPendingTrack;
-	
-	// find the sample offset within the track audio and get its address
-	const int sampleOffset = nCurSamplePos % soundBuf.getSampleCount();
-	const sf::Int16 * pSoundBuf = &soundBuf.getSamples()[sampleOffset];
+	Clip& clip = *m_pClipTable->vClips[nClip];
+	const float fSrcBPM = ClipStretch::GetSourceTempo( clip.GetFileName(), clip.GetFrameCount(), clip.GetSampleRate(), fBPM, nBeatsPerBar );
+	return clip.ConformTempo( fSrcBPM, fBPM );
+}
+
+// If our clips' format changed, so did our
+// length and the size of our fade curves
+void Track::UpdateFormat()
+{
+	auto itClip = std::find_if( m_pClipTable->vClips.begin(), m_pClipTable->vClips.end(), [] ( const std::shared_ptr<Clip>& pClip ) { return pClip != nullptr; } );
+	if ( itClip == m_pClipTable->vClips.end() )
+		return;
+
+	m_nFrameCount = (*itClip)->GetFrameCount();
+
+	std::shared_ptr<ClipTable> pClipTable = std::make_shared<ClipTable>( *m_pClipTable );
+	pClipTable->nChannels = (*itClip)->GetChannelCount();
+	pClipTable->nSampleRate = (*itClip)->GetSampleRate();
+
+	const float framesPerMS = pClipTable->nSampleRate / 1000.f;
+	m_nFadeFrames = m_nNextFadeFrames = (int) (s_fDefaultFadeMS * framesPerMS);
+	m_vFadeIn.reserve( getMaxFadeFrames( pClipTable->nSampleRate ) );
+	buildFadeCurves();
+
+	publishClips( std::move( pClipTable ) );
+}
+
+// Return the index of one of our clips by name
+int Track::GetClipHandle( std::string clipName ) const
+{
+	auto it = m_mapClipHandles.find( clipName );
+	if ( it == m_mapClipHandles.end() )
+		return -1;
+
+	return it->second;
+}
+
+void Track::SetHandle( int nHandle )
+{
+	m_nHandle = nHandle;
+}
+
+void Track::SetReclaimer( EpochReclaimer * pReclaimer )
+{
+	m_pReclaimer = pReclaimer;
+}
+
+// Pick up the latest table; anything that was playing a clip
+// that's since been removed just stops
+void Track::AcquireClips()
+{
+	m_pPlayClips = m_pNextClips.load();
+
+	if ( m_nActiveClip >= 0 && getPlayClip( m_nActiveClip ) == nullptr )
+		m_nActiveClip = -1;
+	if ( m_nPendingClip >= 0 && getPlayClip( m_nPendingClip ) == nullptr )
+		m_nPendingClip = -1;
+	if ( m_nStagedClip >= 0 && getPlayClip( m_nStagedClip ) == nullptr )
+		m_nStagedClip = -1;
+}
+
+// Called from the audio thread, whether nClip is in the table we're
+// playing from (it may have been added since we picked that up)
+bool Track::HasPlayClip( int nClip )
+{
+	return getPlayClip( nClip ) != nullptr;
+}
+
+// A clip from the table we're playing from, or null if it's not there
+Track::Clip * Track::getPlayClip( int nClip )
+{
+	if ( nClip >= 0 && nClip < (int) m_pPlayClips->vClips.size() && m_pPlayClips->vClips[nClip] )
+		return m_pPlayClips->vClips[nClip].get();
+
+	return nullptr;
+}
+
+// Called from the audio thread when it drains a PendingClip command;
+// the staged clip becomes the pending clip at the next boundary
+void Track::StageClip( int nClip )
+{
+	m_nStagedClip = nClip;
+}
+
+// Called from the audio thread at a boundary, if anything was staged
+// since the last one. Tracks with nothing staged get no pending clip,
+// meaning they fade to silence
+void Track::PostStagedClip()
+{
+	m_nPendingClip = m_nStagedClip;
+	m_nStagedClip = -1;
+}
+
+// Called from the audio thread, cuts the track off right away
+void Track::Stop()
+{
+	m_nActiveClip = -1;
+	m_nPendingClip = -1;
+	m_nStagedClip = -1;
+}
+
+// Called from the audio thread at a boundary; that's a line of the
+// launch grid, or the end of our loop if we launch on our own (see
+// ELaunchMode.) If the pending clip differs from the active one it
+// starts playing from its first sample nDelay frames into the segment
+// being mixed, and whatever was playing goes to a voice that lets it
+// ring out underneath
+void Track::Launch( VoicePool& voices, int nDelay )
+{
+	// We can't launch what's been removed
+	if ( m_nPendingClip >= 0 && getPlayClip( m_nPendingClip ) == nullptr )
+		m_nPendingClip = -1;
 
-	// Determine if we're going to be looping to the pending clip and compute
-	// the last sample index we'll be copying
-	bool bLoop = (sampleOffset + nSamplesDesired >= soundBuf.getSampleCount());
-	int lastSample = bLoop ? nSamplesDesired - m_nFadeSamples : nSamplesDesired;
+	if ( m_nPendingClip == m_nActiveClip )
+		return;
 
-	// Add values from sound buf to mix buf, scaling by volume
-	for ( int i = 0; i < lastSample; i++ )
+	// Pick up a new fade if one was set
+	if ( m_nNextFadeFrames != m_nFadeFrames || m_eNextFadeShape != m_eFadeShape )
 	{
-		pMixBuffer[i] += *pSoundBuf++ * vol_1;
+		m_nFadeFrames = m_nNextFadeFrames;
+		m_eFadeShape = m_eNextFadeShape;
+		buildFadeCurves();
 	}
 
-	// If we're looping over
-	if ( bLoop )
+	// Only fade if something was actually playing
+	m_nFadePos = m_nFadeFrames;
+	if ( m_nActiveClip >= 0 && m_nFadeFrames > 0 )
 	{
-		// See if a pending track was set, otherwise fade to silence
-		// The pending track is set via ::setPendingTrack, which is called by
-		// the LoopLauncher in LoopLauncher::updatePendingTracks at the end of 
-		// its longest loop cycle in onGetData, so I guess this is thread safe
-		sf::Int16 nextSample( 0 );
-		if ( m_pPendingClip )
-			nextSample = *(m_pPendingClip->getSamples());
-
-		auto remap = [] ( float x, float m0, float M0, float m1, float M1 )
-		{
-			return (x - m0) / (M0 - m0) * (M1 - m1) + m1;
-		};
-		
-		// Crossfade the current buffer with the first sample of the pending buffer
-		// This is a work in progress, it still pops a bit
-		for ( int i = lastSample, j = 0; i < nSamplesDesired; i++ )
-		{	
-			float a = remap( i, lastSample + 1, nSamplesDesired, 0, 1 );//float( ++j ) / float( m_nFadeSamples );
-			float fVal = *pSoundBuf++ * vol_1;
-			sf::Int16 iVal = (sf::Int16)( a * nextSample + (1.f - a) * fVal );
-			pMixBuffer[i] += iVal;
-		}
+		voices.StartTail( m_nHandle, m_nActiveClip, m_nActiveCursor, nDelay, std::max( m_nFadeFrames, m_nTailFrames ), m_eFadeShape );
+		m_nFadePos = 0;
+	}
 
-		// Assign the active clip to the pending clip, leaving pending clip as is
-		m_pPendingTrack = m_pPendingClip;
+	m_nActiveClip = m_nPendingClip;
+	m_nActiveCursor = 0;
+
+	// Streamed clips have to go back to their head, and can only be
+	// read from one place, so cut off any tail they're still playing
+	if ( m_nActiveClip >= 0 && getPlayClip( m_nActiveClip )->IsStreaming() )
+	{
+		voices.StopClip( m_nHandle, m_nActiveClip );
+		getPlayClip( m_nActiveClip )->Restart();
 	}
+}
 
-	return true;
+// How many frames we can read from nClip at nCursor before it wraps
+// around (or, for streamed clips, before we run out of decoded
+// audio), and the samples we'd read from
+int Track::getClipSpan( int nClip, int nCursor, const sf::Int16 ** ppChannels )
+{
+	return m_pPlayClips->vClips[nClip]->GetSpan( nCursor, ppChannels );
 }
 
-// Returns true of the clip name exists in the map
-bool Track::HasClip( std::string clipName ) const
+// Spans never go past the end of a clip, so
+// wrapping the cursor never takes a modulo
+void Track::advanceCursor( int nClip, int& nCursor, int nFrames )
 {
-	return (m_mapClips.find( clipName ) != m_mapClips.end());
+	nCursor += nFrames;
+	if ( nCursor >= m_pPlayClips->vClips[nClip]->GetFrameCount() )
+		nCursor = 0;
 }
 
-// Set needsAudio to true (?)
-LoopLauncher::LoopLauncher() :
-	sf::SoundStream(),
-	m_nLastSamplePos( 0 ),
-	m_nMaxSampleCount( 0 ),
-	m_bNeedsAudio( true )
+// Called from the audio thread, these ramp in over the next block
+void Track::SetGain( float fGain )
 {
+	m_fGain = fGain;
 }
 
-// Because these own Tracks, which own sf::SoundBuffers,
-// we need the && constructor and operator=
-LoopLauncher::LoopLauncher( LoopLauncher&& other ) :
-	m_nLastSamplePos( other.m_nLastSamplePos ),
-	m_nMaxSampleCount( other.m_nMaxSampleCount ),
-	m_mapTracks( std::move( other.m_mapTracks ) ),
-	m_vMixBuffer( other.m_vMixBuffer ),
-	m_bNeedsAudio( other.m_bNeedsAudio )
+void Track::SetPan( float fPan )
 {
+	// Equal power towards the side we're panning away from
+	const float fAngle = 0.78539816f * (std::max( -1.f, std::min( 1.f, fPan ) ) + 1.f);
+	m_afPanGain[0] = std::min( 1.f, 1.41421356f * std::cos( fAngle ) );
+	m_afPanGain[1] = std::min( 1.f, 1.41421356f * std::sin( fAngle ) );
 }
 
-LoopLauncher& LoopLauncher::operator=( LoopLauncher&& other )
+// Ramp from where we are to where we've been told to be over the
+// block; the mix bus is normalized, so fold the Int16 scale in here
+void Track::BeginBlock( sf::Int64 nFrame, int nFrames )
 {
-	m_nLastSamplePos = other.m_nLastSamplePos;
-	m_nMaxSampleCount = other.m_nMaxSampleCount;
-	m_mapTracks = std::move( other.m_mapTracks );
-	m_vMixBuffer = other.m_vMixBuffer;
-	m_bNeedsAudio = other.m_bNeedsAudio;
+	// LoopLauncher doesn't take streams with more than s_nMaxChannels
+	const int nChannels = m_pPlayClips->nChannels;
+	for ( int c = 0; c < nChannels; c++ )
+	{
+		const float fTarget = m_fGain * (nChannels == 2 ? m_afPanGain[c] : 1.f);
+		m_afRampStart[c] = m_afCurGain[c] / 32768.f;
+		m_afRampStep[c] = (fTarget - m_afCurGain[c]) / (32768.f * std::max( 1, nFrames ));
+		m_afCurGain[c] = fTarget;
+	}
 
-	return *this;
+	m_nRampStartFrame = nFrame;
 }
 
-// This invokes sf::SoundStream::initialize, but not before setting the track map
-// This was done for python, it should be optional
-bool LoopLauncher::Initialize( std::map<std::string, std::list<std::string>> mapTracks )
+void Track::SnapGain()
 {
-	// Construct tracks given the input (dangerous)
-	for ( auto& it : mapTracks )
-		m_mapTracks.emplace( it.first, it.second );
-
-	// If we still have no tracks, get out
-	if ( m_mapTracks.empty() )
-		return false;
+	const int nChannels = m_pPlayClips->nChannels;
+	for ( int c = 0; c < nChannels; c++ )
+		m_afCurGain[c] = m_fGain * (nChannels == 2 ? m_afPanGain[c] : 1.f);
+}
 
-	// Find the min and max sample count
-	int nMinSampleCount = INT_MAX;
-	for ( auto& track : m_mapTracks )
-	{
-		m_nMaxSampleCount = std::max( m_nMaxSampleCount, track.second.GetSampleCount() );
-		nMinSampleCount = std::min( nMinSampleCount, track.second.GetSampleCount() );
-	}
+// Called from the audio thread; if we were waiting for our loop
+// to come around and switch to the grid, we wait for the grid
+void Track::SetLaunchMode( ELaunchMode eLaunchMode )
+{
+	m_eLaunchMode = eLaunchMode;
+}
 
-	// Each sf::SoundStream::onGetData call pushes 1/64th of the 
-	// smallest clip onto the buffer... for no real reason
-	if ( m_mapTracks.empty() == false )
-		m_vMixBuffer.resize( nMinSampleCount / 64 );
+LoopLauncher::ELaunchMode Track::GetLaunchMode() const
+{
+	return m_eLaunchMode;
+}
 
-	// Assuming these are all the same...
-	// initialize with channel count and sample rate
-	Track& t = m_mapTracks.begin()->second;
-	initialize( t.GetChannelCount(), t.GetSampleRate() );
+bool Track::IsPlaying() const
+{
+	return m_nActiveClip >= 0;
+}
 
-	return true;
+// Called from the audio thread; streamed clips can only
+// be read from one place, so they can't be one-shots
+void Track::StartOneShot( VoicePool& voices, int nClip, float fGain )
+{
+	Clip * pClip = getPlayClip( nClip );
+	if ( pClip != nullptr && pClip->IsStreaming() == false )
+		voices.StartOneShot( m_nHandle, nClip, pClip->GetFrameCount(), fGain );
 }
 
-// Return a pointer to an existing track by name, if it exists
-Track * LoopLauncher::GetTrack( std::string trackName ) const
+// Called from the audio thread, takes effect at the next launch;
+// 0 means the outgoing clip only lasts as long as the fade
+void Track::SetTail( int nTailFrames )
 {
-	auto it = m_mapTracks.find( trackName );
-	if ( it == m_mapTracks.end() )
-		return nullptr;
+	m_nTailFrames = std::max( 0, nTailFrames );
+}
 
-	return (Track *) &it->second;
+// Called from the audio thread, takes effect at the next launch
+void Track::SetFade( int nFadeFrames, FadeCurves::EShape eShape )
+{
+	m_nNextFadeFrames = std::max( 1, std::min( nFadeFrames, getMaxFadeFrames( m_pPlayClips->nSampleRate ) ) );
+	m_eNextFadeShape = eShape;
 }
 
-// Construct a track given the name and clip list
-bool LoopLauncher::AddTrack( std::string trackName, std::list<std::string> liFileNames )
+int Track::GetMaxFadeFrames() const
 {
-	bool ret = true;
-	
-	m_mapTracks.emplace( trackName, liFileNames );
+	return getMaxFadeFrames( GetSampleRate() );
+}
 
-	return ret;
+int Track::getMaxFadeFrames( int nSampleRate ) const
+{
+	return (int) (s_fMaxFadeMS * nSampleRate / 1000.f);
 }
 
-// Flush pending clips and invoke sf::SoundStream::play
-void LoopLauncher::Play()
+// Sample the fade table into our fade in; this fits in the
+// storage AddClip reserved, so it doesn't allocate
+void Track::buildFadeCurves()
 {
-	postPendingTracks();
-	sf::SoundStream::play();
+	m_vFadeIn.resize( m_nFadeFrames );
+	FadeCurves::FillFadeIn( m_vFadeIn.data(), m_nFadeFrames, m_eFadeShape );
 }
 
-// Called from main thread, sets the loop launcher's pending clips 
-// which, when needed, will be posted to the audio thread and played
-bool LoopLauncher::UpdatePendingClips( std::list<std::string> liNewActiveClips )
+// This gets called from the audio thread and adds nFrames frames
+// to the mix bus, from wherever our cursor is; nCurFrame is the
+// global frame, which only the gain ramp cares about. The launcher
+// splits blocks at grid lines, so this only has to split them at
+// the end of our own loop when we're launching there
+bool Track::GetAudio( float * const * ppMixBus, int nFrames, sf::Int64 nCurFrame, VoicePool& voices )
 {
-	std::lock_guard<std::mutex> lg( m_muTrackUpdate );
+	// Pointer check
+	if ( ppMixBus == nullptr )
+		return false;
 
-	// It's unfortunate that I have to do an O(n**2) search
-	// here; in the python world I could cache pointers to Track
-	// objects via GetTrack and set them directly, but this was simpler
-	for ( auto& clip : liNewActiveClips )
+	// If we've nothing playing, return false (silence)
+	if ( m_nActiveClip < 0 )
+		return false;
+
+	for ( int nDone = 0; nDone < nFrames; )
 	{
-		for ( auto& itTrack : m_mapTracks )
-		{
-			if ( itTrack.second.HasClip( clip ) )
-			{
-				// Set the entry in the map
-				m_mapPendingTracks[itTrack.first] = clip;
+		// If something's waiting for our loop to come around, stop there
+		int nSegment = nFrames - nDone;
+		const bool bLaunchAtEnd = m_eLaunchMode == ELaunchMode::Loop && m_nActiveClip >= 0 && m_nPendingClip != m_nActiveClip;
+		if ( bLaunchAtEnd )
+			nSegment = std::min( nSegment, m_pPlayClips->vClips[m_nActiveClip]->GetFrameCount() - m_nActiveCursor );
 
-				// We no longer need audio
-				m_bNeedsAudio = false;
+		mixSegment( ppMixBus, nDone, nSegment, nCurFrame + nDone );
+		nDone += nSegment;
 
-				break;
-			}
-		}
+		if ( bLaunchAtEnd && m_nActiveCursor == 0 )
+			Launch( voices, nDone );
 	}
 
-	// Returns true if we actually set a pending clip
-	return (m_bNeedsAudio == false);
+	return true;
 }
 
-// Thread safe access to m_bNeedsAudio
-bool LoopLauncher::NeedsAudio()
+// Mix nFrames frames into the bus starting nOffset frames in. Clips
+// that end partway through wrap around to their start
+void Track::mixSegment( float * const * ppMixBus, int nOffset, int nFrames, sf::Int64 nCurFrame )
 {
-	std::lock_guard<std::mutex> lg( m_muTrackUpdate );
+	const int nChannels = m_pPlayClips->nChannels;
+	int nDone = 0;
+
+	// If we just switched clips, fade the new one in; the
+	// gain ramp and fade curve pick up where we left off
+	while ( m_nActiveClip >= 0 && m_nFadePos < m_nFadeFrames && nDone < nFrames )
+	{
+		const sf::Int16 * apClip[s_nMaxChannels] = { nullptr };
+		int nSpan = std::min( nFrames - nDone, m_nFadeFrames - m_nFadePos );
+		nSpan = std::min( nSpan, getClipSpan( m_nActiveClip, m_nActiveCursor, apClip ) );
+
+		// AddClip won't take empty clips, but if we ever get one
+		// leave the rest of the block silent rather than spin
+		if ( nSpan <= 0 )
+			break;
+
+		const float fRampPos = (float) (nCurFrame + nDone - m_nRampStartFrame);
+		for ( int c = 0; c < nChannels; c++ )
+			MixKernels::ApplyFade( ppMixBus[c] + nOffset + nDone, apClip[c], nSpan, m_afRampStart[c] + fRampPos * m_afRampStep[c], m_afRampStep[c], &m_vFadeIn[m_nFadePos] );
+
+		advanceCursor( m_nActiveClip, m_nActiveCursor, nSpan );
+		nDone += nSpan;
+		m_nFadePos += nSpan;
+	}
+
+	// Add values from the active clip to the mix bus, scaling by gain and pan
+	while ( m_nActiveClip >= 0 && nDone < nFrames )
+	{
+		const sf::Int16 * apClip[s_nMaxChannels] = { nullptr };
+		const int nSpan = std::min( nFrames - nDone, getClipSpan( m_nActiveClip, m_nActiveCursor, apClip ) );
+		if ( nSpan <= 0 )
+			break;
+
+		const float fRampPos = (float) (nCurFrame + nDone - m_nRampStartFrame);
+		for ( int c = 0; c < nChannels; c++ )
+			MixKernels::Accumulate( ppMixBus[c] + nOffset + nDone, apClip[c], nSpan, m_afRampStart[c] + fRampPos * m_afRampStep[c], m_afRampStep[c] );
 
-	return m_bNeedsAudio;
+		advanceCursor( m_nActiveClip, m_nActiveCursor, nSpan );
+		nDone += nSpan;
+	}
 }
 
-// LoopLauncher::postPendingTracks is called from the audio thread
-void LoopLauncher::postPendingTracks()
+// Voices play on after their own clip's end (tails loop it, one-shots
+// stop there), wait out their delay, and fade out if they're tails
+bool Track::MixVoice( VoicePool::Voice& voice, float * const * ppMixBus, int nFrames, sf::Int64 nCurFrame, float * pCurve )
 {
-	std::lock_guard<std::mutex> lg( m_muTrackUpdate );
+	// The clip might have been removed since the voice started
+	if ( getPlayClip( voice.nClip ) == nullptr )
+		return false;
 
-	// I don't like doing this, but it clears out
-	// any clips that won't be playing next
-	for ( auto& track : m_mapTracks )
-		track.second.SetPendingTrack( "silence" );
+	const int nChannels = m_pPlayClips->nChannels;
+	int nDone = std::min( voice.nDelay, nFrames );
+	voice.nDelay -= nDone;
 
-	// Call SetPendingTrack on each of the tracks
-	for ( auto& itTrack : m_mapPendingTracks )
+	while ( voice.nFramesLeft > 0 && nDone < nFrames )
 	{
-		auto it = m_mapTracks.find( itTrack.first );
-		if ( it != m_mapTracks.end() )
+		const sf::Int16 * apClip[s_nMaxChannels] = { nullptr };
+		int nSpan = std::min( nFrames - nDone, voice.nFramesLeft );
+		nSpan = std::min( nSpan, getClipSpan( voice.nClip, voice.nCursor, apClip ) );
+
+		// Same as mixSegment, don't spin on an empty clip
+		if ( nSpan <= 0 )
+		{
+			voice.nFramesLeft = 0;
+			break;
+		}
+
+		const float fRampPos = (float) (nCurFrame + nDone - m_nRampStartFrame);
+		if ( voice.nFadeFrames > 0 )
 		{
-			it->second.SetPendingTrack( itTrack.second );
+			FadeCurves::FillFadeOut( pCurve, voice.nFadeFrames - voice.nFramesLeft, nSpan, voice.nFadeFrames, voice.eShape );
+			for ( int c = 0; c < nChannels; c++ )
+				MixKernels::ApplyFade( ppMixBus[c] + nDone, apClip[c], nSpan, voice.fGain * (m_afRampStart[c] + fRampPos * m_afRampStep[c]), voice.fGain * m_afRampStep[c], pCurve );
 		}
+		else
+		{
+			for ( int c = 0; c < nChannels; c++ )
+				MixKernels::Accumulate( ppMixBus[c] + nDone, apClip[c], nSpan, voice.fGain * (m_afRampStart[c] + fRampPos * m_afRampStep[c]), voice.fGain * m_afRampStep[c] );
+		}
+
+		advanceCursor( voice.nClip, voice.nCursor, nSpan );
+		voice.nFramesLeft -= nSpan;
+		nDone += nSpan;
 	}
 
-	// Clear out any pending tracks
-	m_mapPendingTracks.clear();
+	return voice.nFramesLeft > 0;
+}
 
-	// We now need audio
-	m_bNeedsAudio = true;	
+// Returns true of the clip name exists in the map
+bool Track::HasClip( std::string clipName ) const
+{
+	return (m_mapClipHandles.find( clipName ) != m_mapClipHandles.end());
 }
 
-// LoopLauncher::onGetData is called from the audio thread
-bool LoopLauncher::onGetData( sf::SoundStream::Chunk& c )
+// Clip handles pack the track handle and clip index into one int;
+// anything that doesn't fit gets an invalid handle rather than
+// one that belongs to some other clip
+/*static*/ int LoopLauncher::MakeClipHandle( int nTrack, int nClip )
 {
-	// This shouldn't happen
-	if ( m_vMixBuffer.empty() )
-		return false;
+	if ( nTrack < 0 || nTrack >= s_nMaxTracks || nClip < 0 || nClip >= s_nMaxClipsPerTrack )
+		return -1;
 
-	// Zero out the buffer
-	m_vMixBuffer.assign( m_vMixBuffer.size(), 0 );
+	return (nTrack << 16) | nClip;
+}
 
-	// Assign the chunk values now
-	c.sampleCount = m_vMixBuffer.size();
-	c.samples = m_vMixBuffer.data();
+/*static*/ int LoopLauncher::GetTrackFromClipHandle( int nClipHandle )
+{
+	return nClipHandle >> 16;
+}
 
-	// If we're going to be looping, post pending tracks
-	bool bLoop = c.sampleCount + m_nLastSamplePos >= m_nMaxSampleCount;
-	if ( bLoop )
-	{
-		postPendingTracks();
-	}
+/*static*/ int LoopLauncher::GetClipFromClipHandle( int nClipHandle )
+{
+	return nClipHandle & 0xFFFF;
+}
 
-	// Ask each track to add its audio to the mix buffer
-	for ( auto& track : m_mapTracks )
-		track.second.GetAudio( m_vMixBuffer.data(), m_vMixBuffer.size(), m_nLastSamplePos );
+// Set needsAudio to true (?)
+LoopLauncher::LoopLauncher() :
+	m_pSink( new SFMLSink() ),
+	m_nMaxFrameCount( 0 ),
+	m_nBlockSize( s_nDefaultBlockSize ),
+	m_nPlayFrame( 0 ),
+	m_dGridFrames( 0 ),
+	m_nNextBoundaryFrame( 0 ),
+	m_bPendingUpdate( false ),
+	m_dControlGridFrames( 0 ),
+	m_nPlayedFrame( 0 ),
+	m_pTrackTable( std::make_shared<TrackTable>() ),
+	m_pNextTracks( m_pTrackTable.get() ),
+	m_pPlayTracks( m_pTrackTable.get() ),
+	m_nStreamSampleRate( 0 ),
+	m_nStreamChannels( 0 ),
+	m_bCompressClips( false ),
+	m_nLossyBits( 0 ),
+	m_fProjectBPM( 0.f ),
+	m_nProjectBeatsPerBar( 4 ),
+	m_nVoiceCount( s_nDefaultVoiceCount ),
+	m_nLastCallbackNS( 0 ),
+	m_fLimiterGain( 1.f ),
+	m_nLimiterFrames( 0 ),
+	m_nDitherPos( 0 ),
+	m_bNeedsAudio( true ),
+	m_uSeenBoundaries( 0 )
+{
+	// Fill the dither table with triangular (TPDF) noise, +/- 1 LSB.
+	// A fixed LCG seed keeps renders reproducible
+	unsigned int uSeed = 0x1234567;
+	auto rand01 = [&uSeed] ()
+	{
+		uSeed = uSeed * 1664525u + 1013904223u;
+		return (uSeed >> 8) / float( 1 << 24 );
+	};
 
-	// Incremement sample pos by the size of the mix buffer
-	m_nLastSamplePos += m_vMixBuffer.size();
+	m_vDither.resize( s_nDitherTableSize );
+	for ( float& fDither : m_vDither )
+		fDither = rand01() - rand01();
+}
 
-	// Set to zero if we're going over m_nMaxSampleCount
-	if ( m_nLastSamplePos >= m_nMaxSampleCount )
-		m_nLastSamplePos = 0;
+// Because these own Tracks, which own Clips,
+// we need the && constructor and operator=
+LoopLauncher::LoopLauncher( LoopLauncher&& other ) :
+	m_pSink( std::move( other.m_pSink ) ),
+	m_nMaxFrameCount( other.m_nMaxFrameCount ),
+	m_nBlockSize( other.m_nBlockSize ),
+	m_nPlayFrame( other.m_nPlayFrame ),
+	m_dGridFrames( other.m_dGridFrames ),
+	m_nNextBoundaryFrame( other.m_nNextBoundaryFrame ),
+	m_bPendingUpdate( other.m_bPendingUpdate ),
+	m_dControlGridFrames( other.m_dControlGridFrames ),
+	m_nPlayedFrame( other.m_nPlayedFrame.load() ),
+	m_Timeline( std::move( other.m_Timeline ) ),
+	m_pTrackTable( std::move( other.m_pTrackTable ) ),
+	m_pNextTracks( m_pTrackTable.get() ),
+	m_pPlayTracks( m_pTrackTable.get() ),
+	m_mapTrackHandles( std::move( other.m_mapTrackHandles ) ),
+	m_liLoadFailures( std::move( other.m_liLoadFailures ) ),
+	m_nStreamSampleRate( other.m_nStreamSampleRate ),
+	m_nStreamChannels( other.m_nStreamChannels ),
+	m_bCompressClips( other.m_bCompressClips ),
+	m_nLossyBits( other.m_nLossyBits ),
+	m_fProjectBPM( other.m_fProjectBPM ),
+	m_nProjectBeatsPerBar( other.m_nProjectBeatsPerBar ),
+	m_MixBus( std::move( other.m_MixBus ) ),
+	m_vOutputBuffer( std::move( other.m_vOutputBuffer ) ),
+	m_nVoiceCount( other.m_nVoiceCount ),
+	m_Voices( std::move( other.m_Voices ) ),
+	m_nLastCallbackNS( 0 ),
+	m_fLimiterGain( other.m_fLimiterGain ),
+	m_nLimiterFrames( other.m_nLimiterFrames ),
+	m_vDither( std::move( other.m_vDither ) ),
+	m_nDitherPos( other.m_nDitherPos ),
+	m_bNeedsAudio( other.m_bNeedsAudio.load() ),
+	m_uSeenBoundaries( 0 )
+{
+	// Our tracks retire their clip tables to our reclaimer now,
+	// and the one we came from needs a table to be valid
+	for ( auto& pTrack : m_pTrackTable->vTracks )
+		if ( pTrack )
+			pTrack->SetReclaimer( &m_Reclaimer );
+	other.publishTracks( std::make_shared<TrackTable>() );
+
+	// It needs a sink too, since it still gets stopped
+	other.m_pSink.reset( new NullSink( false ) );
+}
 
-	// For me this always returns true
-	return true;
+LoopLauncher::~LoopLauncher()
+{
+	Stop();
 }
 
-// Not sure what this should do yet
-void LoopLauncher::onSeek( sf::Time t )
+LoopLauncher& LoopLauncher::operator=( LoopLauncher&& other )
 {
-	// NYI
+	// The other one gets a sink that does nothing, so
+	// it's still safe to stop (and destroy) afterwards
+	m_pSink->Stop();
+	m_pSink = std::move( other.m_pSink );
+	other.m_pSink.reset( new NullSink( false ) );
+	m_nMaxFrameCount = other.m_nMaxFrameCount;
+	m_nBlockSize = other.m_nBlockSize;
+	m_nPlayFrame = other.m_nPlayFrame;
+	m_dGridFrames = other.m_dGridFrames;
+	m_nNextBoundaryFrame = other.m_nNextBoundaryFrame;
+	m_bPendingUpdate = other.m_bPendingUpdate;
+	m_dControlGridFrames = other.m_dControlGridFrames;
+	m_nPlayedFrame.store( other.m_nPlayedFrame.load() );
+	m_Timeline = std::move( other.m_Timeline );
+	publishTracks( other.m_pTrackTable );
+	for ( auto& pTrack : m_pTrackTable->vTracks )
+		if ( pTrack )
+			pTrack->SetReclaimer( &m_Reclaimer );
+	other.publishTracks( std::make_shared<TrackTable>() );
+	m_mapTrackHandles = std::move( other.m_mapTrackHandles );
+	m_liLoadFailures = std::move( other.m_liLoadFailures );
+	m_nStreamSampleRate = other.m_nStreamSampleRate;
+	m_nStreamChannels = other.m_nStreamChannels;
+	m_bCompressClips = other.m_bCompressClips;
+	m_nLossyBits = other.m_nLossyBits;
+	m_fProjectBPM = other.m_fProjectBPM;
+	m_nProjectBeatsPerBar = other.m_nProjectBeatsPerBar;
+	m_MixBus = std::move( other.m_MixBus );
+	m_vOutputBuffer = std::move( other.m_vOutputBuffer );
+	m_nVoiceCount = other.m_nVoiceCount;
+	m_Voices = std::move( other.m_Voices );
+	m_fLimiterGain = other.m_fLimiterGain;
+	m_nLimiterFrames = other.m_nLimiterFrames;
+	m_vDither = std::move( other.m_vDither );
+	m_nDitherPos = other.m_nDitherPos;
+	m_bNeedsAudio = other.m_bNeedsAudio.load();
+	m_uSeenBoundaries = m_BoundarySignal.GetCount();
+
+	return *this;
 }
 
-// Initialize all the functions I'd like to be able to call from python
-/*static*/ bool LoopLauncher::PylInit()
+// This sets up the stream, but not before setting the track map
+// This was done for python, it should be optional
+bool LoopLauncher::Initialize( std::map<std::string, std::list<std::string>> mapTracks, int nBlockSize )
 {
-	using namespace pyl;
+	// Load every clip any track wants in parallel, then build the tracks
+	m_liLoadFailures.clear();
+	std::map<std::string, Clip> mapClips = loadClips( mapTracks );
+	for ( auto& it : mapTracks )
+		publishTrack( it.first, assembleTrack( it.second, mapClips ) );
 
-	ModuleDef * pLLModDef = ModuleDef::CreateModuleDef<struct stLoopLauncherModule>( "pylLoopLauncher" );
-	if ( pLLModDef == nullptr )
+	// If we still have no tracks, get out
+	const std::vector<std::shared_ptr<Track>>& vTracks = m_pTrackTable->vTracks;
+	if ( vTracks.empty() )
 		return false;
 
-	pLLModDef->RegisterClass<LoopLauncher>( "LoopLauncher" );
-	pLLModDef->RegisterClass<Track>( "Track" );
-
-	// Really need to make that macro....
-	{
-		std::function<bool(LoopLauncher *, std::map<std::string, std::list<std::string>> )> fnLLInitialize = &LoopLauncher::Initialize;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLInitialize>( "Initialize", fnLLInitialize );
-	}
-	{
-		std::function<void( LoopLauncher * )> fnLoopLauncher_play = &LoopLauncher::Play;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_play>( "Play", fnLoopLauncher_play, "Start or resume playing the audio stream. " );
-	}
+	// Unless we've been told otherwise, the first clip we've got
+	// decides the format, and everything else is conformed to it
+	if ( m_nStreamSampleRate == 0 )
 	{
-		std::function<Track *(LoopLauncher *, std::string)> fnLLGetTrack = &LoopLauncher::GetTrack;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetTrack>( "GetTrack", fnLLGetTrack );
-	}
-	{
-		std::function<bool( LoopLauncher *, std::string, std::list<std::string> )> fnLLAddTrack = &LoopLauncher::AddTrack;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLAddTrack>( "AddTrack", fnLLAddTrack );
-	}
-	{
-		std::function<bool( LoopLauncher * )> fnLLNeedsAudio = &LoopLauncher::NeedsAudio;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLNeedsAudio>( "NeedsAudio", fnLLNeedsAudio );
-	}
-	{
-		std::function<bool( LoopLauncher *, std::list<std::string> liNewActiveClips )> fnLLUpdatePendingClips = &LoopLauncher::UpdatePendingClips;
-		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnUpdatePendingClips>( "UpdatePendingClips", fnLLUpdatePendingClips );
-	}
-	{
-		std::function<bool( Track *, std::string )> fnTAddClip = &Track::AddClip;
-		pLLModDef->RegisterMemFunction<Track, struct st_fnTAddClip>( "AddClip", fnTAddClip );
+		for ( auto& pTrack : vTracks )
+		{
+			if ( pTrack && pTrack->GetClipCount() > 0 )
+			{
+				m_nStreamSampleRate = pTrack->GetSampleRate();
+				m_nStreamChannels = pTrack->GetChannelCount();
+				break;
+			}
+		}
 	}
+	if ( m_nStreamChannels > s_nMaxChannels )
+		return false;
+	conformTracks( vTracks );
+
+	// Find the max frame count, which is the loop length
+	for ( auto& pTrack : vTracks )
+		if ( pTrack )
+			m_nMaxFrameCount = std::max( m_nMaxFrameCount, pTrack->GetFrameCount() );
+
+	// Every clip is in the stream's format now. Each onGetData
+	// call the sink makes pulls one block of audio from the
+	// buffer, regardless of how long the clips are
+	m_nBlockSize = nBlockSize > 0 ? nBlockSize : s_nDefaultBlockSize;
+
+	// The limiter looks ahead as far as it takes to attack; rounded up
+	// to a multiple of 8 frames so the mix still starts aligned
+	m_nLimiterFrames = std::max( 8, ((int) (s_fLimiterAttackSeconds * m_nStreamSampleRate) + 7) & ~7 );
+	m_MixBus.Resize( m_nStreamChannels, m_nLimiterFrames + m_nBlockSize );
+	m_vOutputBuffer.resize( m_nBlockSize * m_nStreamChannels );
+
+	// Voices mix a segment at a time, and segments are never longer than a block
+	m_Voices.Reserve( m_nVoiceCount, m_nBlockSize );
+	m_Timeline.Reserve( s_nTimelineEvents );
+
+	// Clips launch when the longest one loops until told otherwise;
+	// the audio thread isn't running, so we can set this directly
+	m_dGridFrames = computeGridFrames( ELaunchQuantum::Loop, 0.f, 0 );
+	m_dControlGridFrames = m_dGridFrames;
+	m_nNextBoundaryFrame = 0;
+
+	return true;
+}
+
+// How many frames apart grid lines are for a given quantum, or 0
+// if that doesn't make sense (no tempo, no tracks, etc.)
+double LoopLauncher::computeGridFrames( ELaunchQuantum eQuantum, float fBPM, int nBeatsPerBar ) const
+{
+	if ( m_MixBus.IsEmpty() )
+		return 0;
+
+	switch ( eQuantum )
 	{
-		std::function<bool( Track *, std::string )> fnTSetPendingTrack = &Track::SetPendingTrack;
-		pLLModDef->RegisterMemFunction<Track, struct st_fnTSetPendingTrack>( "SetPendingTrack", fnTSetPendingTrack );
+		case ELaunchQuantum::Loop:
+			return double( m_nMaxFrameCount );
+		case ELaunchQuantum::Bar:
+			if ( fBPM <= 0.f || nBeatsPerBar <= 0 )
+				return 0;
+			return 60. * m_nStreamSampleRate * nBeatsPerBar / fBPM;
+		case ELaunchQuantum::Beat:
+			if ( fBPM <= 0.f )
+				return 0;
+			return 60. * m_nStreamSampleRate / fBPM;
 	}
 
-	// These are all the sf::SoundStream functions I'd like to be able to call from python
-	// I don't expose sf::SoundStream::play because I gave LoopLauncher its own ::Play function
-	std::function<void( LoopLauncher * )> fnLoopLauncher_pause = &sf::SoundStream::pause;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_pause>( "Pause", fnLoopLauncher_pause, "Pause the audio stream. " );
+	return 0;
+}
+
+// Called from the main thread; the grid spacing is worked out here
+// and sent over, taking effect at the start of the next block
+bool LoopLauncher::SetLaunchGrid( ELaunchQuantum eQuantum, float fBPM, int nBeatsPerBar )
+{
+	// Anything under a frame apart isn't much of a grid
+	const double dGridFrames = computeGridFrames( eQuantum, fBPM, nBeatsPerBar );
+	if ( dGridFrames < 1. || pushCommand( { Command::EType::Grid, -1, -1, dGridFrames } ) == false )
+		return false;
+
+	m_dControlGridFrames = dGridFrames;
+	return true;
+}
+
+int LoopLauncher::GetBlockSize() const
+{
+	return m_nBlockSize;
+}
+
+float LoopLauncher::GetBlockDurationMS() const
+{
+	return 1000.f * m_nBlockSize / std::max( 1, m_nStreamSampleRate );
+}
+
+// Return a pointer to an existing track by name, if it exists
+Track * LoopLauncher::GetTrack( std::string trackName ) const
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return nullptr;
+
+	return getTrack( nTrack );
+}
+
+// Construct a track given the name and clip list, 
+// returning its index in the track table as a handle
+int LoopLauncher::AddTrack( std::string trackName, std::list<std::string> liFileNames )
+{
+	// Names must be unique
+	if ( m_mapTrackHandles.count( trackName ) )
+		return -1;
+
+	m_liLoadFailures.clear();
+	std::map<std::string, Clip> mapClips = loadClips( { { trackName, liFileNames } } );
+
+	// If we don't know the format yet, Initialize will conform this;
+	// otherwise it has to happen before the audio thread can see it
+	std::shared_ptr<Track> pTrack = assembleTrack( liFileNames, mapClips );
+	if ( m_nStreamSampleRate > 0 )
+		conformTracks( { pTrack } );
+
+	return publishTrack( trackName, std::move( pTrack ) );
+}
+
+// Construct a track out of clips we already have
+int LoopLauncher::AddTrack( std::string trackName, std::map<std::string, Clip> mapClips )
+{
+	std::list<std::string> liClipNames;
+	for ( auto& it : mapClips )
+		liClipNames.push_back( it.first );
 
-	std::function<void( LoopLauncher * )> fnLoopLauncher_stop = &sf::SoundStream::stop;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_stop>( "Stop", fnLoopLauncher_stop, "Stop playing the audio stream. " );
+	m_liLoadFailures.clear();
+	std::shared_ptr<Track> pTrack = assembleTrack( liClipNames, mapClips );
+	if ( m_nStreamSampleRate > 0 )
+		conformTracks( { pTrack } );
 
-	std::function<unsigned int( LoopLauncher * )> fnLoopLauncher_getChannelCount = &sf::SoundStream::getChannelCount;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getChannelCount>( "GetChannelCount", fnLoopLauncher_getChannelCount, "Return the number of channels of the stream. " );
+	return publishTrack( trackName, std::move( pTrack ) );
+}
 
-	std::function<unsigned int( LoopLauncher * )> fnLoopLauncher_getSampleRate = &sf::SoundStream::getSampleRate;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getSampleRate>( "GetSampleRate", fnLoopLauncher_getSampleRate, "Get the stream sample rate of the stream. " );
+// Only before Initialize; after that the stream's format is fixed
+bool LoopLauncher::SetStreamFormat( int nSampleRate, int nChannels )
+{
+	if ( m_MixBus.IsEmpty() == false || nSampleRate <= 0 || nChannels <= 0 || nChannels > s_nMaxChannels )
+		return false;
 
-	std::function<bool( LoopLauncher * )> fnLoopLauncher_getLoop = &sf::SoundStream::getLoop;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getLoop>( "GetLoop", fnLoopLauncher_getLoop, "Tell whether or not the stream is in loop mode. " );
+	m_nStreamSampleRate = nSampleRate;
+	m_nStreamChannels = nChannels;
+	return true;
+}
 
-	std::function<void( LoopLauncher *, bool )> fnLoopLauncher_setLoop = &sf::SoundStream::setLoop;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_setLoop>( "SetLoop", fnLoopLauncher_setLoop, "Set whether or not the stream should loop after reaching the end. " );
+bool LoopLauncher::SetVoiceCount( int nVoices )
+{
+	if ( m_MixBus.IsEmpty() == false || nVoices < 0 )
+		return false;
 
-	std::function<float( LoopLauncher * )> fnLoopLauncher_getVolume = &sf::SoundStream::getVolume;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getVolume>( "GetVolume", fnLoopLauncher_getVolume, "Get the volume of the sound. " );
+	m_nVoiceCount = nVoices;
+	return true;
+}
 
-	std::function<void( LoopLauncher *, float )> fnLoopLauncher_setVolume = &sf::SoundStream::setVolume;
-	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_setVolume>( "SetVolume", fnLoopLauncher_setVolume, "Set the volume of the sound. " );
+bool LoopLauncher::SetClipCompression( bool bCompressClips, int nLossyBits )
+{
+	if ( nLossyBits < 0 || nLossyBits > CompressedClipBuffer::s_nMaxLossyBits )
+		return false;
 
+	m_bCompressClips = bCompressClips;
+	m_nLossyBits = nLossyBits;
 	return true;
-}
\ No newline at end of file
+}
+
+bool LoopLauncher::GetClipCompression() const
+{
+	return m_bCompressClips;
+}
+
+bool LoopLauncher::SetProjectTempo( float fBPM, int nBeatsPerBar )
+{
+	if ( fBPM < 0.f || nBeatsPerBar <= 0 )
+		return false;
+
+	m_fProjectBPM = fBPM;
+	m_nProjectBeatsPerBar = nBeatsPerBar;
+	return true;
+}
+
+float LoopLauncher::GetProjectTempo() const
+{
+	return m_fProjectBPM;
+}
+
+// Conform every clip of these tracks to the project's tempo and the
+// stream's format (and compress it, if we're doing that), one clip
+// per job on the loader pool. This changes clips in place, so the tracks can't be playing;
+// either the stream hasn't started or the tracks haven't been
+// published yet
+void LoopLauncher::conformTracks( const std::vector<std::shared_ptr<Track>>& vTracks )
+{
+	std::vector<std::pair<Track *, int>> vJobs;
+	for ( auto& pTrack : vTracks )
+		if ( pTrack )
+			for ( int c = 0; c < pTrack->GetClipCount(); c++ )
+				vJobs.emplace_back( pTrack.get(), c );
+
+	ClipLoader::ParallelFor( (int) vJobs.size(), [this, &vJobs] ( int nJob )
+	{
+		if ( m_fProjectBPM > 0.f )
+			vJobs[nJob].first->ConformClipTempo( vJobs[nJob].second, m_fProjectBPM, m_nProjectBeatsPerBar );
+		vJobs[nJob].first->ConformClip( vJobs[nJob].second, m_nStreamSampleRate, m_nStreamChannels );
+		if ( m_bCompressClips )
+			vJobs[nJob].first->CompressClip( vJobs[nJob].second, m_nLossyBits );
+	} );
+
+	for ( auto& pTrack : vTracks )
+		if ( pTrack )
+			pTrack->UpdateFormat();
+}
+
+// Decode every distinct file the tracks refer to on the loader pool
+// Files that don't load get added to the failure list
+std::map<std::string, Clip> LoopLauncher::loadClips( const std::map<std::string, std::list<std::string>>& mapTracks )
+{
+	std::vector<std::string> vFileNames;
+	for ( auto& it : mapTracks )
+		vFileNames.insert( vFileNames.end(), it.second.begin(), it.second.end() );
+	std::sort( vFileNames.begin(), vFileNames.end() );
+	vFileNames.erase( std::unique( vFileNames.begin(), vFileNames.end() ), vFileNames.end() );
+
+	std::vector<std::string> vFailures;
+	std::vector<Clip> vClips = ClipLoader::LoadClips( vFileNames, vFailures );
+	m_liLoadFailures.insert( m_liLoadFailures.end(), vFailures.begin(), vFailures.end() );
+
+	std::map<std::string, Clip> mapClips;
+	for ( size_t i = 0; i < vClips.size(); i++ )
+		if ( vClips[i].IsLoaded() )
+			mapClips.emplace( vFileNames[i], std::move( vClips[i] ) );
+
+	return mapClips;
+}
+
+// Build a track out of loaded clips, taking them out of mapClips
+// If another track already took a clip, it gets loaded again; that's
+// a cache hit for decoded clips, and a new stream for streamed ones
+std::shared_ptr<Track> LoopLauncher::assembleTrack( const std::list<std::string>& liFileNames, std::map<std::string, Clip>& mapClips )
+{
+	std::shared_ptr<Track> pTrack = std::make_shared<Track>();
+	Track& track = *pTrack;
+	for ( auto& fileName : liFileNames )
+	{
+		// Skip the ones that didn't load
+		if ( std::find( m_liLoadFailures.begin(), m_liLoadFailures.end(), fileName ) != m_liLoadFailures.end() )
+			continue;
+
+		auto it = mapClips.find( fileName );
+		if ( it != mapClips.end() )
+		{
+			track.AddClip( fileName, std::move( it->second ) );
+			mapClips.erase( it );
+		}
+		else
+		{
+			track.AddClip( fileName );
+		}
+	}
+
+	return pTrack;
+}
+
+// Give the track a handle and publish a table with it on the end
+int LoopLauncher::publishTrack( std::string trackName, std::shared_ptr<Track> pTrack )
+{
+	if ( pTrack == nullptr || m_mapTrackHandles.count( trackName ) )
+		return -1;
+
+	if ( (int) m_pTrackTable->vTracks.size() >= s_nMaxTracks )
+		return -1;
+
+	std::shared_ptr<TrackTable> pTrackTable = std::make_shared<TrackTable>( *m_pTrackTable );
+	const int nTrack = (int) pTrackTable->vTracks.size();
+	pTrack->SetHandle( nTrack );
+	pTrack->SetReclaimer( &m_Reclaimer );
+	pTrackTable->vTracks.push_back( std::move( pTrack ) );
+	m_mapTrackHandles[trackName] = nTrack;
+	publishTracks( std::move( pTrackTable ) );
+
+	return nTrack;
+}
+
+// Swap in a new table, and retire the one it replaces
+void LoopLauncher::publishTracks( std::shared_ptr<const TrackTable> pTrackTable )
+{
+	std::shared_ptr<const TrackTable> pRetired = std::move( m_pTrackTable );
+	m_pTrackTable = std::move( pTrackTable );
+	m_pNextTracks.store( m_pTrackTable.get() );
+	m_Reclaimer.Retire( std::move( pRetired ) );
+}
+
+// Null if there's no such track, or it's been removed
+Track * LoopLauncher::getTrack( int nTrack ) const
+{
+	if ( nTrack < 0 || nTrack >= (int) m_pTrackTable->vTracks.size() )
+		return nullptr;
+
+	return m_pTrackTable->vTracks[nTrack].get();
+}
+
+// The audio thread's version of the above
+Track * LoopLauncher::getPlayTrack( int nTrack )
+{
+	if ( nTrack >= 0 && nTrack < (int) m_pPlayTracks->vTracks.size() && m_pPlayTracks->vTracks[nTrack] )
+		return m_pPlayTracks->vTracks[nTrack].get();
+
+	return nullptr;
+}
+
+// Called at the start of every block, before anything touches a track;
+// the tables we had may have been freed since the last one. Nothing
+// may be mixing when this is called, since it can change what tracks
+// and clips there are
+void LoopLauncher::acquireTracks()
+{
+	m_pPlayTracks = m_pNextTracks.load();
+	for ( auto& pTrack : m_pPlayTracks->vTracks )
+		if ( pTrack )
+			pTrack->AcquireClips();
+}
+
+bool LoopLauncher::RemoveTrack( std::string trackName )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return false;
+
+	std::shared_ptr<TrackTable> pTrackTable = std::make_shared<TrackTable>( *m_pTrackTable );
+	pTrackTable->vTracks[nTrack] = nullptr;
+	m_mapTrackHandles.erase( trackName );
+	publishTracks( std::move( pTrackTable ) );
+
+	return true;
+}
+
+// A track's format comes from its first clip, and setting that up isn't
+// something we can do under the audio thread, so the track needs one
+int LoopLauncher::AddClip( std::string trackName, std::string fileName )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	Track * pTrack = getTrack( nTrack );
+	if ( pTrack == nullptr || pTrack->GetClipCount() == 0 )
+		return -1;
+
+	Clip clip;
+	if ( clip.LoadFromFile( fileName ) == false )
+		return -1;
+
+	if ( m_fProjectBPM > 0.f )
+	{
+		const float fSrcBPM = ClipStretch::GetSourceTempo( fileName, clip.GetFrameCount(), clip.GetSampleRate(), m_fProjectBPM, m_nProjectBeatsPerBar );
+		if ( clip.ConformTempo( fSrcBPM, m_fProjectBPM ) == false )
+			return -1;
+	}
+
+	if ( clip.Conform( pTrack->GetSampleRate(), pTrack->GetChannelCount() ) == false )
+		return -1;
+
+	if ( m_bCompressClips && clip.Compress( m_nLossyBits ) == false )
+		return -1;
+
+	const int nClip = pTrack->AddClip( fileName, std::move( clip ) );
+	if ( nClip < 0 )
+		return -1;
+
+	return MakeClipHandle( nTrack, nClip );
+}
+
+bool LoopLauncher::RemoveClip( std::string clipName )
+{
+	const int nClipHandle = GetClipHandle( clipName );
+	if ( nClipHandle < 0 )
+		return false;
+
+	return getTrack( GetTrackFromClipHandle( nClipHandle ) )->RemoveClip( clipName );
+}
+
+std::list<std::string> LoopLauncher::GetLoadFailures() const
+{
+	return m_liLoadFailures;
+}
+
+// Returns the handle of the named track, or -1
+int LoopLauncher::GetTrackHandle( std::string trackName ) const
+{
+	auto it = m_mapTrackHandles.find( trackName );
+	if ( it == m_mapTrackHandles.end() )
+		return -1;
+
+	return it->second;
+}
+
+// Returns the handle of the first track clip with this name, or -1
+int LoopLauncher::GetClipHandle( std::string clipName ) const
+{
+	for ( int nTrack = 0; nTrack < (int)m_pTrackTable->vTracks.size(); nTrack++ )
+	{
+		const Track * pTrack = getTrack( nTrack );
+		const int nClip = pTrack ? pTrack->GetClipHandle( clipName ) : -1;
+		if ( nClip >= 0 )
+			return MakeClipHandle( nTrack, nClip );
+	}
+
+	return -1;
+}
+
+bool LoopLauncher::SetOutputSink( std::unique_ptr<OutputSink> pSink )
+{
+	if ( pSink == nullptr || IsPlaying() )
+		return false;
+
+	// The old one might be paused, holding on to us
+	m_pSink->Stop();
+	m_pSink = std::move( pSink );
+	return true;
+}
+
+// Flush pending clips and start the output sink
+// The audio thread isn't running yet, so it's safe to
+// drain the command queue from here; the clips get
+// launched by the boundary at the very first frame
+void LoopLauncher::Play()
+{
+	if ( m_MixBus.IsEmpty() || IsPlaying() )
+		return;
+
+	// Don't count however long we were stopped as a callback interval
+	m_nLastCallbackNS.store( 0 );
+	acquireTracks();
+	processCommands();
+	m_pSink->Start( this, m_nStreamChannels, m_nStreamSampleRate );
+}
+
+void LoopLauncher::Pause()
+{
+	m_pSink->Pause();
+}
+
+void LoopLauncher::Stop()
+{
+	m_pSink->Stop();
+}
+
+bool LoopLauncher::IsPlaying() const
+{
+	return m_pSink->IsPlaying();
+}
+
+int LoopLauncher::GetChannelCount() const
+{
+	return m_MixBus.IsEmpty() ? 0 : m_nStreamChannels;
+}
+
+int LoopLauncher::GetSampleRate() const
+{
+	return m_MixBus.IsEmpty() ? 0 : m_nStreamSampleRate;
+}
+
+void LoopLauncher::SetVolume( float fVolume )
+{
+	m_pSink->SetVolume( fVolume );
+}
+
+float LoopLauncher::GetVolume() const
+{
+	return m_pSink->GetVolume();
+}
+
+// Called from main thread, sets the loop launcher's pending clips 
+// which, when needed, will be posted to the audio thread and played
+bool LoopLauncher::UpdatePendingClips( std::list<std::string> liNewActiveClips )
+{
+	// It's unfortunate that I have to do a search per clip
+	// here; python code that cares should cache handles via
+	// GetClipHandle and call UpdatePendingClipHandles instead
+	std::list<int> liClipHandles;
+	for ( auto& clip : liNewActiveClips )
+	{
+		const int nClipHandle = GetClipHandle( clip );
+		if ( nClipHandle >= 0 )
+			liClipHandles.push_back( nClipHandle );
+	}
+
+	return UpdatePendingClipHandles( liClipHandles );
+}
+
+// Called from main thread, same as above but with clip handles
+bool LoopLauncher::UpdatePendingClipHandles( std::list<int> liNewActiveClips )
+{
+	bool bAnyPending = false;
+
+	for ( int nClipHandle : liNewActiveClips )
+	{
+		const int nTrack = GetTrackFromClipHandle( nClipHandle );
+		const int nClip = GetClipFromClipHandle( nClipHandle );
+		const Track * pTrack = getTrack( nTrack );
+		if ( pTrack == nullptr || pTrack->IsClipLoaded( nClip ) == false )
+			continue;
+
+		// Stage the clip on the audio thread
+		if ( pushCommand( { Command::EType::PendingClip, nTrack, nClip, 0. } ) )
+			bAnyPending = true;
+	}
+
+	// We no longer need audio if we actually sent something
+	if ( bAnyPending )
+		m_bNeedsAudio.store( false );
+
+	// Returns true if we actually set a pending clip
+	return bAnyPending;
+}
+
+// Called from main thread, the clips wait on the audio
+// thread's timeline until it gets to nFrame
+bool LoopLauncher::ScheduleClips( sf::Int64 nFrame, std::list<std::string> liClips )
+{
+	std::list<int> liClipHandles;
+	for ( auto& clip : liClips )
+	{
+		const int nClipHandle = GetClipHandle( clip );
+		if ( nClipHandle >= 0 )
+			liClipHandles.push_back( nClipHandle );
+	}
+
+	return ScheduleClipHandles( nFrame, liClipHandles );
+}
+
+bool LoopLauncher::ScheduleClipHandles( sf::Int64 nFrame, std::list<int> liClipHandles )
+{
+	bool bAnyScheduled = false;
+
+	for ( int nClipHandle : liClipHandles )
+	{
+		const int nTrack = GetTrackFromClipHandle( nClipHandle );
+		const int nClip = GetClipFromClipHandle( nClipHandle );
+		const Track * pTrack = getTrack( nTrack );
+		if ( pTrack == nullptr || pTrack->IsClipLoaded( nClip ) == false )
+			continue;
+
+		if ( pushCommand( { Command::EType::Schedule, nTrack, nClip, (double) nFrame } ) )
+			bAnyScheduled = true;
+	}
+
+	return bAnyScheduled;
+}
+
+bool LoopLauncher::ScheduleClipsOnGrid( sf::Int64 nGridLine, std::list<std::string> liClips )
+{
+	if ( m_dControlGridFrames < 1. || nGridLine < 0 )
+		return false;
+
+	return ScheduleClips( std::llround( nGridLine * m_dControlGridFrames ), liClips );
+}
+
+bool LoopLauncher::ClearSchedule()
+{
+	return pushCommand( { Command::EType::Unschedule, -1, -1, 0. } );
+}
+
+sf::Int64 LoopLauncher::GetPlayFrame() const
+{
+	return m_nPlayedFrame.load();
+}
+
+// The same rounding as getNextBoundaryFrame, but with our copy of the grid
+sf::Int64 LoopLauncher::GetNextGridLine() const
+{
+	if ( m_dControlGridFrames < 1. )
+		return -1;
+
+	const sf::Int64 nFrame = m_nPlayedFrame.load();
+	sf::Int64 nLine = (sf::Int64) std::ceil( nFrame / m_dControlGridFrames );
+	while ( nLine > 0 && std::llround( (nLine - 1) * m_dControlGridFrames ) >= nFrame )
+		nLine--;
+	while ( std::llround( nLine * m_dControlGridFrames ) < nFrame )
+		nLine++;
+
+	return nLine;
+}
+
+// Called from main thread, silences a track without waiting for a boundary
+bool LoopLauncher::StopTrack( std::string trackName )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return false;
+
+	return pushCommand( { Command::EType::Stop, nTrack, -1, 0. } );
+}
+
+// Called from main thread, the new gain is picked up at the start of the next block
+bool LoopLauncher::SetTrackGain( std::string trackName, float fGain )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return false;
+
+	return pushCommand( { Command::EType::Gain, nTrack, -1, fGain } );
+}
+
+bool LoopLauncher::SetTrackPan( std::string trackName, float fPan )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return false;
+
+	return pushCommand( { Command::EType::Pan, nTrack, -1, fPan } );
+}
+
+// Called from main thread, the fade length is converted to frames
+// here and clamped to the longest fade the track has room for
+bool LoopLauncher::SetTrackFade( std::string trackName, float fFadeMS, FadeCurves::EShape eShape )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 || fFadeMS <= 0.f )
+		return false;
+
+	const int nFadeFrames = (int) (fFadeMS * getTrack( nTrack )->GetSampleRate() / 1000.f);
+
+	return pushCommand( { Command::EType::Fade, nTrack, (int) eShape, (double) nFadeFrames } );
+}
+
+bool LoopLauncher::SetTrackLaunchMode( std::string trackName, ELaunchMode eLaunchMode )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 )
+		return false;
+
+	return pushCommand( { Command::EType::LaunchMode, nTrack, (int) eLaunchMode, 0. } );
+}
+
+bool LoopLauncher::SetTrackTail( std::string trackName, float fTailMS )
+{
+	const int nTrack = GetTrackHandle( trackName );
+	if ( nTrack < 0 || fTailMS < 0.f )
+		return false;
+
+	const int nTailFrames = (int) (fTailMS * getTrack( nTrack )->GetSampleRate() / 1000.f);
+
+	return pushCommand( { Command::EType::Tail, nTrack, -1, (double) nTailFrames } );
+}
+
+bool LoopLauncher::TriggerClip( std::string clipName, float fGain )
+{
+	const int nClipHandle = GetClipHandle( clipName );
+	if ( nClipHandle < 0 )
+		return false;
+
+	const int nTrack = GetTrackFromClipHandle( nClipHandle );
+	const int nClip = GetClipFromClipHandle( nClipHandle );
+	if ( getTrack( nTrack )->IsClipStreaming( nClip ) )
+		return false;
+
+	return pushCommand( { Command::EType::OneShot, nTrack, nClip, (double) fGain } );
+}
+
+// Thread safe access to m_bNeedsAudio
+// Since the control loop polls this, it's where we free whatever
+// the audio thread has finished with
+bool LoopLauncher::NeedsAudio()
+{
+	m_Reclaimer.Reclaim();
+	return m_bNeedsAudio.load();
+}
+
+// Called from the main thread instead of polling NeedsAudio, so it
+// frees retired tables the way NeedsAudio does; otherwise they'd hang
+// around until the next time something got published
+bool LoopLauncher::WaitForBoundary( int nTimeoutMS )
+{
+	const unsigned int uCount = m_BoundarySignal.Wait( m_uSeenBoundaries, nTimeoutMS );
+	m_Reclaimer.Reclaim();
+	if ( uCount == m_uSeenBoundaries )
+		return false;
+
+	m_uSeenBoundaries = uCount;
+	return true;
+}
+
+// Called from the main thread; if the queue is full
+// the audio thread has fallen way behind and we drop it
+bool LoopLauncher::pushCommand( Command cmd )
+{
+	return m_qCommands.Push( cmd );
+}
+
+// LoopLauncher::processCommands is called from the audio thread
+// at the start of every block, it never blocks
+void LoopLauncher::processCommands()
+{
+	Command cmd;
+	bool bNewClips = false;
+	while ( m_qCommands.Pop( cmd ) )
+	{
+		// Commands that aren't for a track have no track handle
+		Track * pTrack = nullptr;
+		if ( cmd.nTrack >= 0 )
+		{
+			// The track or clip may have been added after we picked up
+			// this block's tables, in which case we pick them up again.
+			// Commands for tracks that have been removed are dropped
+			const bool bClip = cmd.eType == Command::EType::PendingClip || cmd.eType == Command::EType::OneShot || cmd.eType == Command::EType::Schedule;
+			pTrack = getPlayTrack( cmd.nTrack );
+			if ( pTrack == nullptr || (bClip && cmd.nClip >= 0 && pTrack->HasPlayClip( cmd.nClip ) == false) )
+			{
+				acquireTracks();
+				pTrack = getPlayTrack( cmd.nTrack );
+			}
+			if ( pTrack == nullptr )
+				continue;
+		}
+
+		switch ( cmd.eType )
+		{
+			case Command::EType::PendingClip:
+				pTrack->StageClip( cmd.nClip );
+				m_bPendingUpdate = true;
+				bNewClips = true;
+				break;
+			case Command::EType::Stop:
+				pTrack->Stop();
+				m_Voices.StopTrack( cmd.nTrack );
+				break;
+			case Command::EType::Gain:
+				pTrack->SetGain( (float)cmd.dValue );
+				break;
+			case Command::EType::Pan:
+				pTrack->SetPan( (float)cmd.dValue );
+				break;
+			case Command::EType::Fade:
+				pTrack->SetFade( (int) cmd.dValue, (FadeCurves::EShape) cmd.nClip );
+				break;
+			case Command::EType::LaunchMode:
+				pTrack->SetLaunchMode( (ELaunchMode) cmd.nClip );
+				break;
+			case Command::EType::Tail:
+				pTrack->SetTail( (int) cmd.dValue );
+				break;
+			case Command::EType::OneShot:
+				pTrack->StartOneShot( m_Voices, cmd.nClip, (float) cmd.dValue );
+				break;
+			case Command::EType::Grid:
+				m_dGridFrames = cmd.dValue;
+				m_nNextBoundaryFrame = getNextBoundaryFrame( m_nPlayFrame );
+				break;
+			case Command::EType::Schedule:
+				m_Timeline.Insert( { (sf::Int64) cmd.dValue, cmd.nTrack, cmd.nClip } );
+				break;
+			case Command::EType::Unschedule:
+				m_Timeline.Clear();
+				break;
+		}
+	}
+
+	if ( bNewClips )
+		postStagedLoopClips();
+}
+
+// Playing tracks that launch on their own loop don't wait for the
+// grid, so their new clips are pending as soon as we get them
+void LoopLauncher::postStagedLoopClips()
+{
+	for ( auto& pTrack : m_pPlayTracks->vTracks )
+		if ( pTrack && pTrack->GetLaunchMode() == ELaunchMode::Loop && pTrack->IsPlaying() )
+			pTrack->PostStagedClip();
+}
+
+// Called from the audio thread when the play frame gets to the next
+// event on the timeline; this stages everything that's due, like a
+// PendingClip command would. We can't pick up new tables mid block,
+// but processCommands did that if the clips were new to us
+void LoopLauncher::applyTimeline()
+{
+	bool bNewClips = false;
+	Timeline::Event event;
+	while ( m_Timeline.Pop( m_nPlayFrame, event ) )
+	{
+		Track * pTrack = getPlayTrack( event.nTrack );
+		if ( pTrack == nullptr || pTrack->HasPlayClip( event.nClip ) == false )
+			continue;
+
+		pTrack->StageClip( event.nClip );
+		m_bPendingUpdate = true;
+		bNewClips = true;
+	}
+
+	if ( bNewClips )
+		postStagedLoopClips();
+}
+
+// The first grid line at or after nFrame. Grid lines are
+// rounded to whole frames from their exact (fractional) time,
+// so they don't drift when the spacing isn't a whole number
+sf::Int64 LoopLauncher::getNextBoundaryFrame( sf::Int64 nFrame ) const
+{
+	if ( m_dGridFrames < 1. )
+		return std::numeric_limits<sf::Int64>::max();
+
+	sf::Int64 nLine = (sf::Int64) std::ceil( nFrame / m_dGridFrames );
+	while ( nLine > 0 && std::llround( (nLine - 1) * m_dGridFrames ) >= nFrame )
+		nLine--;
+	while ( std::llround( nLine * m_dGridFrames ) < nFrame )
+		nLine++;
+
+	return std::llround( nLine * m_dGridFrames );
+}
+
+// LoopLauncher::launchPendingTracks is called from the audio
+// thread when the play frame lands on a grid line
+void LoopLauncher::launchPendingTracks()
+{
+	// If anything was staged since the last boundary, every track's
+	// staged clip becomes its pending clip; tracks with nothing staged
+	// will fade out to silence. If nothing was, everything keeps going.
+	// Playing tracks that launch on their own loop have already posted
+	// theirs, and launch from GetAudio when their loop comes around
+	if ( m_bPendingUpdate )
+	{
+		for ( auto& pTrack : m_pPlayTracks->vTracks )
+			if ( pTrack && (pTrack->GetLaunchMode() == ELaunchMode::Grid || pTrack->IsPlaying() == false) )
+				pTrack->PostStagedClip();
+		m_bPendingUpdate = false;
+	}
+
+	for ( auto& pTrack : m_pPlayTracks->vTracks )
+		if ( pTrack && (pTrack->GetLaunchMode() == ELaunchMode::Grid || pTrack->IsPlaying() == false) )
+			pTrack->Launch( m_Voices, 0 );
+
+	// We now need audio; wake the control thread if it's waiting
+	m_bNeedsAudio.store( true );
+	m_BoundarySignal.Notify();
+}
+
+// LoopLauncher::onGetData is called from the audio thread,
+// which is whichever thread the output sink pulls on
+bool LoopLauncher::onGetData( OutputSink::Chunk& chunk )
+{
+	// This shouldn't happen
+	if ( m_MixBus.IsEmpty() )
+		return false;
+
+	// Nothing in here may touch the heap (see AllocTrap)
+	AllocTrap::Scope allocTrap;
+
+	using Clock = std::chrono::steady_clock;
+	const long long nStartNS = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+
+	// Pick up the tracks and clips we have now, and anything the
+	// control thread sent us; nothing we pick up is freed until Exit
+	m_Reclaimer.Enter();
+	acquireTracks();
+	processCommands();
+
+	// Mix a block into the output buffer
+	renderBlock( m_nBlockSize );
+	m_Reclaimer.Exit();
+
+	// Record how long that took and how long it's been since last time
+	const long long nEndNS = std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+	const long long nLastNS = m_nLastCallbackNS.exchange( nStartNS );
+	const unsigned int uIntervalUS = nLastNS > 0 ? (unsigned int) ((nStartNS - nLastNS) / 1000) : 0;
+	m_Stats.RecordCallback( (unsigned int) ((nEndNS - nStartNS) / 1000), uIntervalUS, m_nBlockSize, 1000.f * GetBlockDurationMS() );
+
+	// Assign the chunk values now
+	chunk.nSamples = m_vOutputBuffer.size();
+	chunk.pSamples = m_vOutputBuffer.data();
+
+	// For me this always returns true
+	return true;
+}
+
+// Mix nFrames (at most a block) into the first nFrames frames of
+// the output buffer. This is the whole mixing path, shared by the
+// audio thread and offline rendering
+void LoopLauncher::renderBlock( int nFrames )
+{
+	// Zero out the bus, past the limiter's lookahead
+	const int nChannels = m_MixBus.GetChannelCount();
+	for ( int c = 0; c < nChannels; c++ )
+		std::fill( m_MixBus.GetChannel( c ) + m_nLimiterFrames, m_MixBus.GetChannel( c ) + m_nLimiterFrames + nFrames, 0.f );
+
+	// Gain and pan changes ramp across the whole block,
+	// however many segments it gets split into
+	for ( auto& pTrack : m_pPlayTracks->vTracks )
+		if ( pTrack )
+			pTrack->BeginBlock( m_nPlayFrame, nFrames );
+
+	// Render the block in segments split at grid lines, so
+	// that clips launch on the exact frame of the boundary
+	for ( int nDone = 0; nDone < nFrames; )
+	{
+		// Scheduled clips are staged on their frame, before
+		// a boundary on the same frame launches them
+		if ( m_Timeline.GetNextFrame() <= m_nPlayFrame )
+			applyTimeline();
+
+		if ( m_nPlayFrame == m_nNextBoundaryFrame )
+		{
+			// Posting clips is the expensive part of a boundary, so time it
+			if ( m_bPendingUpdate )
+			{
+				using Clock = std::chrono::steady_clock;
+				const Clock::time_point tStart = Clock::now();
+				launchPendingTracks();
+				m_Stats.RecordBoundaryPost( (unsigned int) std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - tStart ).count() );
+			}
+			else
+				launchPendingTracks();
+			m_nNextBoundaryFrame = getNextBoundaryFrame( m_nPlayFrame + 1 );
+		}
+
+		const sf::Int64 nSegmentEnd = std::min( m_nNextBoundaryFrame, m_Timeline.GetNextFrame() );
+		const int nSegment = (int) std::min<sf::Int64>( nFrames - nDone, nSegmentEnd - m_nPlayFrame );
+
+		// Ask each track to add its audio to the mix bus
+		float * apBus[s_nMaxChannels];
+		for ( int c = 0; c < nChannels; c++ )
+			apBus[c] = m_MixBus.GetChannel( c ) + m_nLimiterFrames + nDone;
+		for ( auto& pTrack : m_pPlayTracks->vTracks )
+			if ( pTrack )
+				pTrack->GetAudio( apBus, nSegment, m_nPlayFrame, m_Voices );
+		mixVoices( apBus, nSegment );
+
+		nDone += nSegment;
+		m_nPlayFrame += nSegment;
+	}
+
+	// Limit the bus and write it out as Int16
+	limitAndConvert( nFrames );
+	m_nPlayedFrame.store( m_nPlayFrame );
+}
+
+// Mix every active voice through its track, freeing the finished ones
+void LoopLauncher::mixVoices( float * const * ppMixBus, int nFrames )
+{
+	if ( m_Voices.GetActiveCount() == 0 )
+		return;
+
+	for ( VoicePool::Voice& voice : m_Voices.GetVoices() )
+	{
+		if ( voice.nTrack < 0 )
+			continue;
+
+		// If the voice's track or clip has been removed it goes quiet
+		Track * pTrack = getPlayTrack( voice.nTrack );
+		if ( pTrack == nullptr || pTrack->MixVoice( voice, ppMixBus, nFrames, m_nPlayFrame, m_Voices.GetCurve() ) == false )
+			m_Voices.Release( voice );
+	}
+}
+
+std::map<std::string, double> LoopLauncher::GetStats() const
+{
+	std::map<std::string, double> mapStats = m_Stats.GetSummary();
+
+	int nUnderruns = 0;
+	for ( auto& pTrack : m_pTrackTable->vTracks )
+		if ( pTrack )
+			nUnderruns += pTrack->GetUnderrunCount();
+	mapStats["stream_underruns"] = nUnderruns;
+	mapStats["voices_active"] = m_Voices.GetActiveCount();
+	mapStats["voices_stolen"] = m_Voices.GetStolenCount();
+	mapStats["timeline_events"] = m_Timeline.GetEventCount();
+	mapStats["timeline_dropped"] = m_Timeline.GetDroppedCount();
+	if ( AllocTrap::IsEnabled() )
+		mapStats["alloc_traps"] = AllocTrap::GetTrapCount();
+
+	// Over 1 means we can't keep up
+	const double dBlockUS = 1000. * GetBlockDurationMS();
+	mapStats["load_mean"] = mapStats["callback_us_mean"] / dBlockUS;
+	mapStats["load_max"] = mapStats["callback_us_max"] / dBlockUS;
+
+	return mapStats;
+}
+
+std::vector<int> LoopLauncher::GetStatsHistogram( std::string histogramName ) const
+{
+	return m_Stats.GetHistogram( histogramName );
+}
+
+void LoopLauncher::ResetStats()
+{
+	m_Stats.Reset();
+}
+
+// Start over from frame 0 with every track silent at the gain it's
+// been set to, and the limiter and dither where they were when we
+// were created
+void LoopLauncher::resetPlayback()
+{
+	for ( auto& pTrack : m_pTrackTable->vTracks )
+	{
+		if ( pTrack )
+		{
+			pTrack->Stop();
+			pTrack->SnapGain();
+		}
+	}
+	m_Voices.Clear();
+	m_Timeline.Clear();
+
+	m_nPlayFrame = 0;
+	m_nPlayedFrame.store( 0 );
+	m_nNextBoundaryFrame = 0;
+	m_bPendingUpdate = false;
+	m_fLimiterGain = 1.f;
+	m_nDitherPos = 0;
+	for ( int c = 0; c < m_MixBus.GetChannelCount(); c++ )
+		std::fill( m_MixBus.GetChannel( c ), m_MixBus.GetChannel( c ) + m_nLimiterFrames, 0.f );
+}
+
+// Render nFrames frames to a WAV file as fast as we can, with no audio
+// device involved. Playback starts over from frame 0 with all tracks
+// silent; mapEvents maps frames to the clips to make pending at that
+// frame, exactly as if UpdatePendingClips had been called right then.
+// Commands sent before this are drained first, so track settings
+// (gain, pan, fades, launch modes, the grid) hold for the render, but
+// any clips they launched, scheduled or triggered are thrown away;
+// what gets played depends only on mapEvents. Can't be called while
+// we're playing, since it uses the same state
+bool LoopLauncher::Render( std::string fileName, int nFrames, std::map<int, std::list<std::string>> mapEvents )
+{
+	if ( m_MixBus.IsEmpty() || nFrames < 0 || IsPlaying() )
+		return false;
+
+	const int nChannels = m_nStreamChannels;
+	sf::OutputSoundFile file;
+	if ( file.openFromFile( fileName, m_nStreamSampleRate, nChannels ) == false )
+		return false;
+
+	// We're the only thread touching the queue, so it's safe to drain
+	acquireTracks();
+	processCommands();
+	resetPlayback();
+
+	// The limiter delays everything by its lookahead, so render that
+	// much more and skip it at the start; the file lines up with mapEvents
+	const int nRenderFrames = nFrames + m_nLimiterFrames;
+	auto itEvent = mapEvents.begin();
+	for ( int nDone = 0; nDone < nRenderFrames; )
+	{
+		// Apply everything scheduled for now; we're the only
+		// thread touching the queue, so drain it right away
+		for ( ; itEvent != mapEvents.end() && itEvent->first <= nDone; ++itEvent )
+		{
+			UpdatePendingClips( itEvent->second );
+			AllocTrap::Scope allocTrap;
+			processCommands();
+		}
+
+		// Render up to a block, stopping short of the next event
+		int nBlock = std::min( m_nBlockSize, nRenderFrames - nDone );
+		if ( itEvent != mapEvents.end() )
+			nBlock = std::min( nBlock, itEvent->first - nDone );
+
+		// This is the audio thread's path, so hold it to the same rules
+		{
+			AllocTrap::Scope allocTrap;
+			renderBlock( nBlock );
+		}
+		const int nSkip = std::max( 0, std::min( nBlock, m_nLimiterFrames - nDone ) );
+		file.write( m_vOutputBuffer.data() + nSkip * nChannels, (nBlock - nSkip) * nChannels );
+
+		nDone += nBlock;
+	}
+
+	return true;
+}
+
+// Called from renderBlock once all tracks are on the bus. This is a
+// lookahead peak limiter: what comes out is the bus delayed by
+// m_nLimiterFrames, and it goes out in pieces that long. Each piece's
+// gain ramps from wherever the last one left off to what puts both it
+// and the piece after it (which we can already see) under the ceiling,
+// so the gain is already down by the time a peak gets played, and
+// never jumps. Otherwise it releases exponentially toward unity. The
+// ramps, dither, saturating Int16 conversion and interleaving all
+// happen in MixKernels::ToInt16
+void LoopLauncher::limitAndConvert( int nFrames )
+{
+	const int nChannels = m_MixBus.GetChannelCount();
+	const float fReleaseFrames = s_fLimiterReleaseSeconds * std::max( 1, m_nStreamSampleRate );
+
+	const float * apBus[s_nMaxChannels];
+	for ( int nDone = 0; nDone < nFrames; )
+	{
+		// The gain that would put this piece and the next one under the ceiling
+		const int nAttack = std::min( m_nLimiterFrames, nFrames - nDone );
+		float fPeak = 0.f;
+		for ( int c = 0; c < nChannels; c++ )
+			fPeak = std::max( fPeak, MixKernels::PeakAbs( m_MixBus.GetChannel( c ) + nDone, nAttack + m_nLimiterFrames ) );
+		const float fTargetGain = fPeak > s_fLimiterCeiling ? s_fLimiterCeiling / fPeak : 1.f;
+
+		// Release exponentially, but never past the target
+		const float fReleased = 1.f - (1.f - m_fLimiterGain) * std::exp( -nAttack / fReleaseFrames );
+		const float fGain1 = std::min( fTargetGain, fReleased );
+		const float fGainStep = (fGain1 - m_fLimiterGain) / nAttack;
+
+		// Convert in pieces that fit in what's left of the dither table,
+		// which is indexed by interleaved sample rather than by frame
+		for ( int nPart = 0; nPart < nAttack; )
+		{
+			const int nChunk = std::min( nAttack - nPart, (s_nDitherTableSize - m_nDitherPos) / nChannels );
+			if ( nChunk == 0 )
+			{
+				// Not enough left for a whole frame
+				m_nDitherPos = 0;
+				continue;
+			}
+
+			for ( int c = 0; c < nChannels; c++ )
+				apBus[c] = m_MixBus.GetChannel( c ) + nDone + nPart;
+			MixKernels::ToInt16( &m_vOutputBuffer[(nDone + nPart) * nChannels], apBus, nChannels, nChunk, m_fLimiterGain + nPart * fGainStep, fGainStep, &m_vDither[m_nDitherPos] );
+
+			nPart += nChunk;
+			m_nDitherPos = (m_nDitherPos + nChunk * nChannels) % s_nDitherTableSize;
+		}
+
+		m_fLimiterGain = fGain1;
+		nDone += nAttack;
+	}
+
+	// What we didn't get to play is the next block's lookahead
+	for ( int c = 0; c < nChannels; c++ )
+	{
+		float * pBus = m_MixBus.GetChannel( c );
+		std::copy( pBus + nFrames, pBus + nFrames + m_nLimiterFrames, pBus );
+	}
+}
+
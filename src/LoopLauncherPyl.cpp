@@ -0,0 +1,297 @@
+#include "LoopLauncher.h"
+#include "ClipCache.h"
+#include "TempoCache.h"
+#include "SFMLSink.h"
+#include "NullSink.h"
+#include "FileSink.h"
+
+#include <pyliason.h>
+
+// LoopLauncher's python bindings live here rather than in LoopLauncher.cpp,
+// so the engine itself can be built without python (see CMakeLists.txt)
+
+// Initialize all the functions I'd like to be able to call from python
+/*static*/ bool LoopLauncher::PylInit()
+{
+	using namespace pyl;
+
+	ModuleDef * pLLModDef = ModuleDef::CreateModuleDef<struct stLoopLauncherModule>( "pylLoopLauncher" );
+	if ( pLLModDef == nullptr )
+		return false;
+
+	// Tracks aren't exposed; the audio thread plays them, so everything
+	// goes through the launcher's command queue and clip tables
+	pLLModDef->RegisterClass<LoopLauncher>( "LoopLauncher" );
+
+	// Really need to make that macro....
+	{
+		// Clips are decoded on the loader pool, which doesn't need the GIL
+		std::function<bool(LoopLauncher *, std::map<std::string, std::list<std::string>>, int )> fnLLInitialize = [] ( LoopLauncher * pLL, std::map<std::string, std::list<std::string>> mapTracks, int nBlockSize )
+		{
+			bool bRet = false;
+			Py_BEGIN_ALLOW_THREADS
+			bRet = pLL->Initialize( mapTracks, nBlockSize );
+			Py_END_ALLOW_THREADS
+			return bRet;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLInitialize>( "Initialize", fnLLInitialize, "Load tracks and set the block size in sample frames (0 for the default). " );
+	}
+	{
+		// Rendering doesn't need the GIL either
+		std::function<bool( LoopLauncher *, std::string, int, std::map<int, std::list<std::string>> )> fnLLRender = [] ( LoopLauncher * pLL, std::string fileName, int nFrames, std::map<int, std::list<std::string>> mapEvents )
+		{
+			bool bRet = false;
+			Py_BEGIN_ALLOW_THREADS
+			bRet = pLL->Render( fileName, nFrames, mapEvents );
+			Py_END_ALLOW_THREADS
+			return bRet;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLRender>( "Render", fnLLRender, "Render frames to a WAV file offline, given a dict of frame : [clips to make pending]. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, int, int )> fnLLSetStreamFormat = &LoopLauncher::SetStreamFormat;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetStreamFormat>( "SetStreamFormat", fnLLSetStreamFormat, "Set the sample rate and channel count clips are conformed to; call before Initialize. " );
+	}
+	{
+		std::function<std::list<std::string>( LoopLauncher * )> fnLLGetLoadFailures = &LoopLauncher::GetLoadFailures;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetLoadFailures>( "GetLoadFailures", fnLLGetLoadFailures, "Return the files that failed to load in the last Initialize or AddTrack. " );
+	}
+	{
+		std::function<std::map<std::string, double>( LoopLauncher * )> fnLLGetStats = &LoopLauncher::GetStats;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetStats>( "GetStats", fnLLGetStats, "Return a dict of audio callback counters, timing percentiles and load. " );
+	}
+	{
+		std::function<std::vector<int>( LoopLauncher *, std::string )> fnLLGetStatsHistogram = &LoopLauncher::GetStatsHistogram;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetStatsHistogram>( "GetStatsHistogram", fnLLGetStatsHistogram, "Return the power of two bucket counts for callback_us, interval_us, block_frames or boundary_ns. " );
+	}
+	{
+		std::function<void( LoopLauncher * )> fnLLResetStats = &LoopLauncher::ResetStats;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLResetStats>( "ResetStats", fnLLResetStats, "Clear the audio callback statistics. " );
+	}
+	{
+		std::function<int( LoopLauncher * )> fnLLGetBlockSize = &LoopLauncher::GetBlockSize;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetBlockSize>( "GetBlockSize", fnLLGetBlockSize, "Return the number of sample frames rendered per block. " );
+	}
+	{
+		std::function<float( LoopLauncher * )> fnLLGetBlockDurationMS = &LoopLauncher::GetBlockDurationMS;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetBlockDurationMS>( "GetBlockDurationMS", fnLLGetBlockDurationMS, "Return the duration of one block in milliseconds. " );
+	}
+	{
+		std::function<void( LoopLauncher * )> fnLoopLauncher_play = &LoopLauncher::Play;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_play>( "Play", fnLoopLauncher_play, "Start or resume playing the audio stream. " );
+	}
+	{
+		std::function<int( LoopLauncher *, std::string, std::list<std::string> )> fnLLAddTrack = [] ( LoopLauncher * pLL, std::string trackName, std::list<std::string> liFileNames )
+		{
+			int nTrack = -1;
+			Py_BEGIN_ALLOW_THREADS
+			nTrack = pLL->AddTrack( trackName, liFileNames );
+			Py_END_ALLOW_THREADS
+			return nTrack;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLAddTrack>( "AddTrack", fnLLAddTrack );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string )> fnLLRemoveTrack = &LoopLauncher::RemoveTrack;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLRemoveTrack>( "RemoveTrack", fnLLRemoveTrack, "Remove a track while playing; it stops where it is and its handle isn't reused. " );
+	}
+	{
+		// Loading the file doesn't need the GIL
+		std::function<int( LoopLauncher *, std::string, std::string )> fnLLAddClip = [] ( LoopLauncher * pLL, std::string trackName, std::string fileName )
+		{
+			int nClip = -1;
+			Py_BEGIN_ALLOW_THREADS
+			nClip = pLL->AddClip( trackName, fileName );
+			Py_END_ALLOW_THREADS
+			return nClip;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLAddClip>( "AddClip", fnLLAddClip, "Load a clip onto a track while playing and return its clip handle, or -1. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string )> fnLLRemoveClip = &LoopLauncher::RemoveClip;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLRemoveClip>( "RemoveClip", fnLLRemoveClip, "Remove a clip while playing; if it's active its track goes silent. " );
+	}
+	{
+		std::function<int( LoopLauncher *, std::string )> fnLLGetTrackHandle = &LoopLauncher::GetTrackHandle;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetTrackHandle>( "GetTrackHandle", fnLLGetTrackHandle );
+	}
+	{
+		std::function<int( LoopLauncher *, std::string )> fnLLGetClipHandle = &LoopLauncher::GetClipHandle;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetClipHandle>( "GetClipHandle", fnLLGetClipHandle );
+	}
+	{
+		std::function<bool( LoopLauncher * )> fnLLNeedsAudio = &LoopLauncher::NeedsAudio;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLNeedsAudio>( "NeedsAudio", fnLLNeedsAudio );
+	}
+	{
+		// Let other python threads run while we sleep
+		std::function<bool( LoopLauncher *, int )> fnLLWaitForBoundary = [] ( LoopLauncher * pLL, int nTimeoutMS )
+		{
+			bool bRet = false;
+			Py_BEGIN_ALLOW_THREADS
+			bRet = pLL->WaitForBoundary( nTimeoutMS );
+			Py_END_ALLOW_THREADS
+			return bRet;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLWaitForBoundary>( "WaitForBoundary", fnLLWaitForBoundary, "Sleep until the next launch boundary or the timeout in ms (negative waits forever); True if there was one. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::list<std::string> liNewActiveClips )> fnLLUpdatePendingClips = &LoopLauncher::UpdatePendingClips;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnUpdatePendingClips>( "UpdatePendingClips", fnLLUpdatePendingClips );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::list<int> liNewActiveClips )> fnLLUpdatePendingClipHandles = &LoopLauncher::UpdatePendingClipHandles;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnUpdatePendingClipHandles>( "UpdatePendingClipHandles", fnLLUpdatePendingClipHandles );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string )> fnLLStopTrack = &LoopLauncher::StopTrack;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLStopTrack>( "StopTrack", fnLLStopTrack );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string, float )> fnLLSetTrackGain = &LoopLauncher::SetTrackGain;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetTrackGain>( "SetTrackGain", fnLLSetTrackGain );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string, float )> fnLLSetTrackPan = &LoopLauncher::SetTrackPan;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetTrackPan>( "SetTrackPan", fnLLSetTrackPan, "Set a track's pan, from -1 (left) to 1 (right); ramps in over the next block. " );
+	}
+	{
+		// Python passes the fade shape as a string
+		std::function<bool( LoopLauncher *, std::string, float, std::string )> fnLLSetTrackFade = [] ( LoopLauncher * pLL, std::string trackName, float fFadeMS, std::string strShape )
+		{
+			if ( strShape == "linear" )
+				return pLL->SetTrackFade( trackName, fFadeMS, FadeCurves::EShape::Linear );
+			if ( strShape == "equalpower" )
+				return pLL->SetTrackFade( trackName, fFadeMS, FadeCurves::EShape::EqualPower );
+			return false;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetTrackFade>( "SetTrackFade", fnLLSetTrackFade, "Set a track's crossfade length in ms and shape ('linear' or 'equalpower'). " );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string, std::string )> fnLLSetTrackLaunchMode = [] ( LoopLauncher * pLL, std::string trackName, std::string strMode )
+		{
+			if ( strMode == "grid" )
+				return pLL->SetTrackLaunchMode( trackName, LoopLauncher::ELaunchMode::Grid );
+			if ( strMode == "loop" )
+				return pLL->SetTrackLaunchMode( trackName, LoopLauncher::ELaunchMode::Loop );
+			return false;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetTrackLaunchMode>( "SetTrackLaunchMode", fnLLSetTrackLaunchMode, "Switch a track's clips on the launch grid ('grid') or at the end of its own loop ('loop'). " );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string, float )> fnLLSetTrackTail = &LoopLauncher::SetTrackTail;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetTrackTail>( "SetTrackTail", fnLLSetTrackTail, "Let the clip a track switches away from ring out for this many ms as it fades. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, std::string, float )> fnLLTriggerClip = &LoopLauncher::TriggerClip;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLTriggerClip>( "TriggerClip", fnLLTriggerClip, "Play a clip through once at the given gain, on top of whatever its track is playing. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, int )> fnLLSetVoiceCount = &LoopLauncher::SetVoiceCount;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetVoiceCount>( "SetVoiceCount", fnLLSetVoiceCount, "Set how many tails and one-shots can play at once; call before Initialize. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, bool, int )> fnLLSetClipCompression = &LoopLauncher::SetClipCompression;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetClipCompression>( "SetClipCompression", fnLLSetClipCompression, "Keep clips loaded from now on compressed in memory, dropping this many low bits (0 for lossless), and decode them as they play. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, float, int )> fnLLSetProjectTempo = &LoopLauncher::SetProjectTempo;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetProjectTempo>( "SetProjectTempo", fnLLSetProjectTempo, "Stretch clips loaded from now on to this BPM (and beats per bar) without changing their pitch; 0 turns it off. " );
+	}
+	{
+		// Python passes the quantum as a string
+		std::function<bool( LoopLauncher *, std::string, float, int )> fnLLSetLaunchGrid = [] ( LoopLauncher * pLL, std::string strQuantum, float fBPM, int nBeatsPerBar )
+		{
+			if ( strQuantum == "loop" )
+				return pLL->SetLaunchGrid( LoopLauncher::ELaunchQuantum::Loop, fBPM, nBeatsPerBar );
+			if ( strQuantum == "bar" )
+				return pLL->SetLaunchGrid( LoopLauncher::ELaunchQuantum::Bar, fBPM, nBeatsPerBar );
+			if ( strQuantum == "beat" )
+				return pLL->SetLaunchGrid( LoopLauncher::ELaunchQuantum::Beat, fBPM, nBeatsPerBar );
+			return false;
+		};
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLSetLaunchGrid>( "SetLaunchGrid", fnLLSetLaunchGrid, "Quantize launches to 'loop', 'bar' or 'beat' given a tempo and beats per bar. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, sf::Int64, std::list<std::string> )> fnLLScheduleClips = &LoopLauncher::ScheduleClips;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLScheduleClips>( "ScheduleClips", fnLLScheduleClips, "Make clips pending when playback gets to a frame, as UpdatePendingClips would. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, sf::Int64, std::list<int> )> fnLLScheduleClipHandles = &LoopLauncher::ScheduleClipHandles;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLScheduleClipHandles>( "ScheduleClipHandles", fnLLScheduleClipHandles, "Same as ScheduleClips, with handles from GetClipHandle. " );
+	}
+	{
+		std::function<bool( LoopLauncher *, sf::Int64, std::list<std::string> )> fnLLScheduleClipsOnGrid = &LoopLauncher::ScheduleClipsOnGrid;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLScheduleClipsOnGrid>( "ScheduleClipsOnGrid", fnLLScheduleClipsOnGrid, "Make clips pending on a line of the launch grid, counting from frame 0. " );
+	}
+	{
+		std::function<bool( LoopLauncher * )> fnLLClearSchedule = &LoopLauncher::ClearSchedule;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLClearSchedule>( "ClearSchedule", fnLLClearSchedule, "Drop every scheduled clip that hasn't been made pending yet. " );
+	}
+	{
+		std::function<sf::Int64( LoopLauncher * )> fnLLGetPlayFrame = &LoopLauncher::GetPlayFrame;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetPlayFrame>( "GetPlayFrame", fnLLGetPlayFrame, "Return how many frames have been mixed. " );
+	}
+	{
+		std::function<sf::Int64( LoopLauncher * )> fnLLGetNextGridLine = &LoopLauncher::GetNextGridLine;
+		pLLModDef->RegisterMemFunction<LoopLauncher, struct st_fnLLGetNextGridLine>( "GetNextGridLine", fnLLGetNextGridLine, "Return the soonest grid line clips can be scheduled on. " );
+	}
+
+	// Playback goes through the output sink; Play is registered above
+	std::function<void( LoopLauncher * )> fnLoopLauncher_pause = &LoopLauncher::Pause;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_pause>( "Pause", fnLoopLauncher_pause, "Pause the audio stream. " );
+
+	std::function<void( LoopLauncher * )> fnLoopLauncher_stop = &LoopLauncher::Stop;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_stop>( "Stop", fnLoopLauncher_stop, "Stop playing the audio stream. " );
+
+	std::function<bool( LoopLauncher * )> fnLoopLauncher_isPlaying = &LoopLauncher::IsPlaying;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_isPlaying>( "IsPlaying", fnLoopLauncher_isPlaying, "Tell whether the output sink is pulling audio. " );
+
+	std::function<int( LoopLauncher * )> fnLoopLauncher_getChannelCount = &LoopLauncher::GetChannelCount;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getChannelCount>( "GetChannelCount", fnLoopLauncher_getChannelCount, "Return the number of channels of the stream. " );
+
+	std::function<int( LoopLauncher * )> fnLoopLauncher_getSampleRate = &LoopLauncher::GetSampleRate;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getSampleRate>( "GetSampleRate", fnLoopLauncher_getSampleRate, "Get the stream sample rate of the stream. " );
+
+	std::function<float( LoopLauncher * )> fnLoopLauncher_getVolume = &LoopLauncher::GetVolume;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_getVolume>( "GetVolume", fnLoopLauncher_getVolume, "Get the volume of the sound. " );
+
+	std::function<void( LoopLauncher *, float )> fnLoopLauncher_setVolume = &LoopLauncher::SetVolume;
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_setVolume>( "SetVolume", fnLoopLauncher_setVolume, "Set the volume of the sound. " );
+
+	// Python picks a sink by name: 'sfml' is the audio device, 'null' and
+	// 'clocked' throw the audio away (as fast as it's mixed, or in real
+	// time), and 'wav' and 'wav_clocked' write it to fileName
+	std::function<bool( LoopLauncher *, std::string, std::string )> fnLoopLauncher_setOutputSink = [] ( LoopLauncher * pLL, std::string strSink, std::string fileName )
+	{
+		std::unique_ptr<OutputSink> pSink;
+		if ( strSink == "sfml" )
+			pSink.reset( new SFMLSink() );
+		else if ( strSink == "null" || strSink == "clocked" )
+			pSink.reset( new NullSink( strSink == "clocked" ) );
+		else if ( strSink == "wav" || strSink == "wav_clocked" )
+			pSink.reset( new FileSink( fileName, strSink == "wav_clocked" ) );
+
+		return pLL->SetOutputSink( std::move( pSink ) );
+	};
+	pLLModDef->RegisterMemFunction<LoopLauncher, struct fnLoopLauncher_st_setOutputSink>( "SetOutputSink", fnLoopLauncher_setOutputSink, "Send audio to 'sfml', 'null', 'clocked', 'wav' or 'wav_clocked' (with a file name); not while playing. " );
+
+	// The clip cache is shared by every launcher, so these are module functions
+	std::function<void( bool )> fnSetClipContentHashing = &ClipCache::SetContentHashing;
+	pLLModDef->RegisterFunction<struct st_fnSetClipContentHashing>( "SetClipContentHashing", fnSetClipContentHashing, "Also share decoded clips whose audio is identical under different names. " );
+
+	std::function<int()> fnGetClipCacheEntryCount = &ClipCache::GetEntryCount;
+	pLLModDef->RegisterFunction<struct st_fnGetClipCacheEntryCount>( "GetClipCacheEntryCount", fnGetClipCacheEntryCount, "Return the number of decoded clips held by the clip cache. " );
+
+	std::function<int()> fnGetClipCacheMB = [] () { return (int) (ClipCache::GetByteCount() >> 20); };
+	pLLModDef->RegisterFunction<struct st_fnGetClipCacheMB>( "GetClipCacheMB", fnGetClipCacheMB, "Return the size of the decoded clips in the clip cache in MB. " );
+
+	// As is the folder tempo changed clips are kept in
+	std::function<void( std::string )> fnSetTempoCacheDir = &TempoCache::SetDirectory;
+	pLLModDef->RegisterFunction<struct st_fnSetTempoCacheDir>( "SetTempoCacheDir", fnSetTempoCacheDir, "Keep clips stretched to the project tempo in this folder; an empty name stops keeping them. " );
+
+	std::function<std::string()> fnGetTempoCacheDir = &TempoCache::GetDirectory;
+	pLLModDef->RegisterFunction<struct st_fnGetTempoCacheDir>( "GetTempoCacheDir", fnGetTempoCacheDir, "Return the folder clips stretched to the project tempo are kept in. " );
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,591 @@
+#include "MixKernels.h"
+
+#include <atomic>
+#include <cmath>
+
+// We only have vector kernels for x86
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+#define LL_MIX_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#define LL_MIX_X86 0
+#endif
+
+// GCC and clang need to be told a function can use AVX2
+// instructions even though the rest of the file can't;
+// MSVC lets you use any intrinsic anywhere
+#if LL_MIX_X86 && (defined( __GNUC__ ) || defined( __clang__ ))
+#define LL_TARGET_SSE2 __attribute__(( target( "sse2" ) ))
+#define LL_TARGET_AVX2 __attribute__(( target( "avx2" ) ))
+#else
+#define LL_TARGET_SSE2
+#define LL_TARGET_AVX2
+#endif
+
+namespace MixKernels
+{
+	// The scalar versions are the reference; the vector versions
+	// must do the same float ops in the same order, one lane per i
+	namespace Scalar
+	{
+		inline float rampGain( float fGain0, float fGainStep, int i )
+		{
+			return fGain0 + (float) i * fGainStep;
+		}
+
+		void Accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, int nFirst = 0 )
+		{
+			for ( int i = nFirst; i < nFrames; i++ )
+				pDst[i] = pDst[i] + (float) pSrc[i] * rampGain( fGain0, fGainStep, i );
+		}
+
+		void ApplyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve, int nFirst = 0 )
+		{
+			for ( int i = nFirst; i < nFrames; i++ )
+				pDst[i] = pDst[i] + (pCurve[i] * (float) pSrc[i]) * rampGain( fGain0, fGainStep, i );
+		}
+
+		float PeakAbs( const float * pSrc, int nSamples, float fPeak = 0.f, int nFirst = 0 )
+		{
+			for ( int i = nFirst; i < nSamples; i++ )
+			{
+				const float fAbs = std::fabs( pSrc[i] );
+				fPeak = fAbs > fPeak ? fAbs : fPeak;
+			}
+
+			return fPeak;
+		}
+
+		inline sf::Int16 toInt16( float fSample, float fGain, float fDither )
+		{
+			float fVal = fSample * fGain * 32767.f + fDither;
+
+			// Saturate, then round to nearest
+			fVal = fVal < -32768.f ? -32768.f : fVal;
+			fVal = fVal > 32767.f ? 32767.f : fVal;
+			return (sf::Int16) std::lrint( fVal );
+		}
+
+		// One contiguous channel, which is all mono needs
+		void ToInt16( sf::Int16 * pDst, const float * pSrc, int nFrames, float fGain0, float fGainStep, const float * pDither, int nFirst = 0 )
+		{
+			for ( int i = nFirst; i < nFrames; i++ )
+				pDst[i] = toInt16( pSrc[i], rampGain( fGain0, fGainStep, i ), pDither[i] );
+		}
+
+		void ToInt16( sf::Int16 * pDst, const float * const * ppSrc, int nChannels, int nFrames, float fGain0, float fGainStep, const float * pDither, int nFirst = 0 )
+		{
+			for ( int i = nFirst; i < nFrames; i++ )
+			{
+				const float fGain = rampGain( fGain0, fGainStep, i );
+				for ( int c = 0; c < nChannels; c++ )
+				{
+					const int k = i * nChannels + c;
+					pDst[k] = toInt16( ppSrc[c][i], fGain, pDither[k] );
+				}
+			}
+		}
+
+		// Add up the 8 partial sums of a dot product
+		inline float reduce8( const float * afSum )
+		{
+			return ((afSum[0] + afSum[1]) + (afSum[2] + afSum[3])) + ((afSum[4] + afSum[5]) + (afSum[6] + afSum[7]));
+		}
+
+		float DotProduct( const float * pA, const float * pB, int nSamples )
+		{
+			float afSum[8] = { 0.f };
+			for ( int i = 0; i + 8 <= nSamples; i += 8 )
+				for ( int l = 0; l < 8; l++ )
+					afSum[l] = afSum[l] + pA[i + l] * pB[i + l];
+
+			return reduce8( afSum );
+		}
+	}
+
+#if LL_MIX_X86
+	namespace SSE2
+	{
+		// Sign extend the low / high four Int16s of v to floats
+		LL_TARGET_SSE2 inline __m128 widenLo( __m128i v )
+		{
+			return _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+		}
+
+		LL_TARGET_SSE2 inline __m128 widenHi( __m128i v )
+		{
+			return _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( v, v ), 16 ) );
+		}
+
+		// The gains for the four frames starting at i
+		LL_TARGET_SSE2 inline __m128 rampGain( __m128 vGain0, __m128 vGainStep, int i )
+		{
+			const __m128 vIdx = _mm_cvtepi32_ps( _mm_add_epi32( _mm_set1_epi32( i ), _mm_setr_epi32( 0, 1, 2, 3 ) ) );
+			return _mm_add_ps( vGain0, _mm_mul_ps( vIdx, vGainStep ) );
+		}
+
+		LL_TARGET_SSE2 void Accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep )
+		{
+			const __m128 vGain0 = _mm_set1_ps( fGain0 );
+			const __m128 vGainStep = _mm_set1_ps( fGainStep );
+
+			// 8 frames at a time
+			int i = 0;
+			for ( ; i + 8 <= nFrames; i += 8 )
+			{
+				const __m128i vSrc = _mm_loadu_si128( (const __m128i *) (pSrc + i) );
+
+				_mm_storeu_ps( pDst + i, _mm_add_ps( _mm_loadu_ps( pDst + i ), _mm_mul_ps( widenLo( vSrc ), rampGain( vGain0, vGainStep, i ) ) ) );
+				_mm_storeu_ps( pDst + i + 4, _mm_add_ps( _mm_loadu_ps( pDst + i + 4 ), _mm_mul_ps( widenHi( vSrc ), rampGain( vGain0, vGainStep, i + 4 ) ) ) );
+			}
+
+			// Whatever's left over
+			Scalar::Accumulate( pDst, pSrc, nFrames, fGain0, fGainStep, i );
+		}
+
+		LL_TARGET_SSE2 void ApplyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve )
+		{
+			const __m128 vGain0 = _mm_set1_ps( fGain0 );
+			const __m128 vGainStep = _mm_set1_ps( fGainStep );
+
+			int i = 0;
+			for ( ; i + 8 <= nFrames; i += 8 )
+			{
+				const __m128i vSrc = _mm_loadu_si128( (const __m128i *) (pSrc + i) );
+
+				// Low four frames then high four
+				for ( int h = 0; h < 2; h++ )
+				{
+					const int j = i + 4 * h;
+					const __m128 vFaded = _mm_mul_ps( _mm_loadu_ps( pCurve + j ), h ? widenHi( vSrc ) : widenLo( vSrc ) );
+					_mm_storeu_ps( pDst + j, _mm_add_ps( _mm_loadu_ps( pDst + j ), _mm_mul_ps( vFaded, rampGain( vGain0, vGainStep, j ) ) ) );
+				}
+			}
+
+			Scalar::ApplyFade( pDst, pSrc, nFrames, fGain0, fGainStep, pCurve, i );
+		}
+
+		LL_TARGET_SSE2 float PeakAbs( const float * pSrc, int nSamples )
+		{
+			// Clearing the sign bit is fabs
+			const __m128 vAbsMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) );
+			__m128 vPeak = _mm_setzero_ps();
+
+			int i = 0;
+			for ( ; i + 4 <= nSamples; i += 4 )
+				vPeak = _mm_max_ps( vPeak, _mm_and_ps( _mm_loadu_ps( pSrc + i ), vAbsMask ) );
+
+			// Max is order independent, so reducing the lanes is exact
+			float afPeak[4];
+			_mm_storeu_ps( afPeak, vPeak );
+			const float fPeak = Scalar::PeakAbs( afPeak, 4 );
+
+			return Scalar::PeakAbs( pSrc, nSamples, fPeak, i );
+		}
+
+		// Scale and dither, then saturate and round to nearest (the
+		// default MXCSR mode, same as lrint)
+		LL_TARGET_SSE2 inline __m128i toInt32( __m128 fScaled, const float * pDither )
+		{
+			const __m128 fVal = _mm_add_ps( fScaled, _mm_loadu_ps( pDither ) );
+			return _mm_cvtps_epi32( _mm_min_ps( _mm_max_ps( fVal, _mm_set1_ps( -32768.f ) ), _mm_set1_ps( 32767.f ) ) );
+		}
+
+		LL_TARGET_SSE2 void ToInt16( sf::Int16 * pDst, const float * pSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			const __m128 vGain0 = _mm_set1_ps( fGain0 );
+			const __m128 vGainStep = _mm_set1_ps( fGainStep );
+			const __m128 vScale = _mm_set1_ps( 32767.f );
+
+			int i = 0;
+			for ( ; i + 8 <= nFrames; i += 8 )
+			{
+				__m128i vHalf[2];
+				for ( int h = 0; h < 2; h++ )
+				{
+					const int j = i + 4 * h;
+					const __m128 fScaled = _mm_mul_ps( _mm_mul_ps( _mm_loadu_ps( pSrc + j ), rampGain( vGain0, vGainStep, j ) ), vScale );
+					vHalf[h] = toInt32( fScaled, pDither + j );
+				}
+
+				_mm_storeu_si128( (__m128i *) (pDst + i), _mm_packs_epi32( vHalf[0], vHalf[1] ) );
+			}
+
+			Scalar::ToInt16( pDst, pSrc, nFrames, fGain0, fGainStep, pDither, i );
+		}
+
+		LL_TARGET_SSE2 void ToInt16Stereo( sf::Int16 * pDst, const float * const * ppSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			const __m128 vGain0 = _mm_set1_ps( fGain0 );
+			const __m128 vGainStep = _mm_set1_ps( fGainStep );
+			const __m128 vScale = _mm_set1_ps( 32767.f );
+			const float * pL = ppSrc[0];
+			const float * pR = ppSrc[1];
+
+			// 4 frames (8 samples) at a time; both channels get the same
+			// gain, and are interleaved after scaling but before dithering
+			int i = 0;
+			for ( ; i + 4 <= nFrames; i += 4 )
+			{
+				const __m128 vGain = rampGain( vGain0, vGainStep, i );
+				const __m128 fL = _mm_mul_ps( _mm_mul_ps( _mm_loadu_ps( pL + i ), vGain ), vScale );
+				const __m128 fR = _mm_mul_ps( _mm_mul_ps( _mm_loadu_ps( pR + i ), vGain ), vScale );
+
+				const __m128i vLo = toInt32( _mm_unpacklo_ps( fL, fR ), pDither + 2 * i );
+				const __m128i vHi = toInt32( _mm_unpackhi_ps( fL, fR ), pDither + 2 * i + 4 );
+				_mm_storeu_si128( (__m128i *) (pDst + 2 * i), _mm_packs_epi32( vLo, vHi ) );
+			}
+
+			Scalar::ToInt16( pDst, ppSrc, 2, nFrames, fGain0, fGainStep, pDither, i );
+		}
+
+		LL_TARGET_SSE2 float DotProduct( const float * pA, const float * pB, int nSamples )
+		{
+			// Partial sums 0 - 3 and 4 - 7
+			__m128 vSumLo = _mm_setzero_ps();
+			__m128 vSumHi = _mm_setzero_ps();
+			for ( int i = 0; i + 8 <= nSamples; i += 8 )
+			{
+				vSumLo = _mm_add_ps( vSumLo, _mm_mul_ps( _mm_loadu_ps( pA + i ), _mm_loadu_ps( pB + i ) ) );
+				vSumHi = _mm_add_ps( vSumHi, _mm_mul_ps( _mm_loadu_ps( pA + i + 4 ), _mm_loadu_ps( pB + i + 4 ) ) );
+			}
+
+			float afSum[8];
+			_mm_storeu_ps( afSum, vSumLo );
+			_mm_storeu_ps( afSum + 4, vSumHi );
+			return Scalar::reduce8( afSum );
+		}
+	}
+
+	namespace AVX2
+	{
+		LL_TARGET_AVX2 inline __m256 widenLo( __m256i v )
+		{
+			return _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( _mm256_castsi256_si128( v ) ) );
+		}
+
+		LL_TARGET_AVX2 inline __m256 widenHi( __m256i v )
+		{
+			return _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( _mm256_extracti128_si256( v, 1 ) ) );
+		}
+
+		// The gains for the 8 frames starting at i
+		LL_TARGET_AVX2 inline __m256 rampGain( __m256 vGain0, __m256 vGainStep, int i )
+		{
+			const __m256 vIdx = _mm256_cvtepi32_ps( _mm256_add_epi32( _mm256_set1_epi32( i ), _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+			return _mm256_add_ps( vGain0, _mm256_mul_ps( vIdx, vGainStep ) );
+		}
+
+		LL_TARGET_AVX2 void Accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep )
+		{
+			const __m256 vGain0 = _mm256_set1_ps( fGain0 );
+			const __m256 vGainStep = _mm256_set1_ps( fGainStep );
+
+			// 16 frames at a time
+			int i = 0;
+			for ( ; i + 16 <= nFrames; i += 16 )
+			{
+				const __m256i vSrc = _mm256_loadu_si256( (const __m256i *) (pSrc + i) );
+
+				_mm256_storeu_ps( pDst + i, _mm256_add_ps( _mm256_loadu_ps( pDst + i ), _mm256_mul_ps( widenLo( vSrc ), rampGain( vGain0, vGainStep, i ) ) ) );
+				_mm256_storeu_ps( pDst + i + 8, _mm256_add_ps( _mm256_loadu_ps( pDst + i + 8 ), _mm256_mul_ps( widenHi( vSrc ), rampGain( vGain0, vGainStep, i + 8 ) ) ) );
+			}
+
+			Scalar::Accumulate( pDst, pSrc, nFrames, fGain0, fGainStep, i );
+		}
+
+		LL_TARGET_AVX2 void ApplyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve )
+		{
+			const __m256 vGain0 = _mm256_set1_ps( fGain0 );
+			const __m256 vGainStep = _mm256_set1_ps( fGainStep );
+
+			int i = 0;
+			for ( ; i + 16 <= nFrames; i += 16 )
+			{
+				const __m256i vSrc = _mm256_loadu_si256( (const __m256i *) (pSrc + i) );
+
+				for ( int h = 0; h < 2; h++ )
+				{
+					const int j = i + 8 * h;
+					const __m256 vFaded = _mm256_mul_ps( _mm256_loadu_ps( pCurve + j ), h ? widenHi( vSrc ) : widenLo( vSrc ) );
+					_mm256_storeu_ps( pDst + j, _mm256_add_ps( _mm256_loadu_ps( pDst + j ), _mm256_mul_ps( vFaded, rampGain( vGain0, vGainStep, j ) ) ) );
+				}
+			}
+
+			Scalar::ApplyFade( pDst, pSrc, nFrames, fGain0, fGainStep, pCurve, i );
+		}
+
+		LL_TARGET_AVX2 float PeakAbs( const float * pSrc, int nSamples )
+		{
+			const __m256 vAbsMask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7FFFFFFF ) );
+			__m256 vPeak = _mm256_setzero_ps();
+
+			int i = 0;
+			for ( ; i + 8 <= nSamples; i += 8 )
+				vPeak = _mm256_max_ps( vPeak, _mm256_and_ps( _mm256_loadu_ps( pSrc + i ), vAbsMask ) );
+
+			float afPeak[8];
+			_mm256_storeu_ps( afPeak, vPeak );
+			const float fPeak = Scalar::PeakAbs( afPeak, 8 );
+
+			return Scalar::PeakAbs( pSrc, nSamples, fPeak, i );
+		}
+
+		LL_TARGET_AVX2 inline __m256i toInt32( __m256 fScaled, const float * pDither )
+		{
+			const __m256 fVal = _mm256_add_ps( fScaled, _mm256_loadu_ps( pDither ) );
+			return _mm256_cvtps_epi32( _mm256_min_ps( _mm256_max_ps( fVal, _mm256_set1_ps( -32768.f ) ), _mm256_set1_ps( 32767.f ) ) );
+		}
+
+		// _mm256_packs_epi32 packs within 128 bit lanes, so put them back in order
+		LL_TARGET_AVX2 inline void store16( sf::Int16 * pDst, __m256i vLo, __m256i vHi )
+		{
+			_mm256_storeu_si256( (__m256i *) pDst, _mm256_permute4x64_epi64( _mm256_packs_epi32( vLo, vHi ), 0xD8 ) );
+		}
+
+		LL_TARGET_AVX2 void ToInt16( sf::Int16 * pDst, const float * pSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			const __m256 vGain0 = _mm256_set1_ps( fGain0 );
+			const __m256 vGainStep = _mm256_set1_ps( fGainStep );
+			const __m256 vScale = _mm256_set1_ps( 32767.f );
+
+			int i = 0;
+			for ( ; i + 16 <= nFrames; i += 16 )
+			{
+				__m256i vHalf[2];
+				for ( int h = 0; h < 2; h++ )
+				{
+					const int j = i + 8 * h;
+					const __m256 fScaled = _mm256_mul_ps( _mm256_mul_ps( _mm256_loadu_ps( pSrc + j ), rampGain( vGain0, vGainStep, j ) ), vScale );
+					vHalf[h] = toInt32( fScaled, pDither + j );
+				}
+
+				store16( pDst + i, vHalf[0], vHalf[1] );
+			}
+
+			Scalar::ToInt16( pDst, pSrc, nFrames, fGain0, fGainStep, pDither, i );
+		}
+
+		LL_TARGET_AVX2 void ToInt16Stereo( sf::Int16 * pDst, const float * const * ppSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			const __m256 vGain0 = _mm256_set1_ps( fGain0 );
+			const __m256 vGainStep = _mm256_set1_ps( fGainStep );
+			const __m256 vScale = _mm256_set1_ps( 32767.f );
+			const float * pL = ppSrc[0];
+			const float * pR = ppSrc[1];
+
+			// 8 frames (16 samples) at a time
+			int i = 0;
+			for ( ; i + 8 <= nFrames; i += 8 )
+			{
+				const __m256 vGain = rampGain( vGain0, vGainStep, i );
+				const __m256 fL = _mm256_mul_ps( _mm256_mul_ps( _mm256_loadu_ps( pL + i ), vGain ), vScale );
+				const __m256 fR = _mm256_mul_ps( _mm256_mul_ps( _mm256_loadu_ps( pR + i ), vGain ), vScale );
+
+				// Unpacking works within 128 bit lanes, so this gives frames
+				// 0 1 | 4 5 and 2 3 | 6 7; swap the middle halves to get 0 - 3 and 4 - 7
+				const __m256 fLo = _mm256_unpacklo_ps( fL, fR );
+				const __m256 fHi = _mm256_unpackhi_ps( fL, fR );
+				const __m256i vLo = toInt32( _mm256_permute2f128_ps( fLo, fHi, 0x20 ), pDither + 2 * i );
+				const __m256i vHi = toInt32( _mm256_permute2f128_ps( fLo, fHi, 0x31 ), pDither + 2 * i + 8 );
+				store16( pDst + 2 * i, vLo, vHi );
+			}
+
+			Scalar::ToInt16( pDst, ppSrc, 2, nFrames, fGain0, fGainStep, pDither, i );
+		}
+
+		LL_TARGET_AVX2 float DotProduct( const float * pA, const float * pB, int nSamples )
+		{
+			__m256 vSum = _mm256_setzero_ps();
+			for ( int i = 0; i + 8 <= nSamples; i += 8 )
+				vSum = _mm256_add_ps( vSum, _mm256_mul_ps( _mm256_loadu_ps( pA + i ), _mm256_loadu_ps( pB + i ) ) );
+
+			float afSum[8];
+			_mm256_storeu_ps( afSum, vSum );
+			return Scalar::reduce8( afSum );
+		}
+	}
+#endif // LL_MIX_X86
+
+	// The dispatch table, one entry per kernel
+	struct Kernels
+	{
+		EISA eISA;
+		void( *pfnAccumulate )(float *, const sf::Int16 *, int, float, float);
+		void( *pfnApplyFade )(float *, const sf::Int16 *, int, float, float, const float *);
+		float( *pfnPeakAbs )(const float *, int);
+		void( *pfnToInt16 )(sf::Int16 *, const float *, int, float, float, const float *);
+		void( *pfnToInt16Stereo )(sf::Int16 *, const float * const *, int, float, float, const float *);
+		float( *pfnDotProduct )(const float *, const float *, int);
+	};
+
+	// The scalar kernels have trailing default arguments,
+	// so wrap them to get the right function pointer types
+	namespace Scalar
+	{
+		void accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep )
+		{
+			Accumulate( pDst, pSrc, nFrames, fGain0, fGainStep );
+		}
+
+		void applyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve )
+		{
+			ApplyFade( pDst, pSrc, nFrames, fGain0, fGainStep, pCurve );
+		}
+
+		float peakAbs( const float * pSrc, int nSamples )
+		{
+			return PeakAbs( pSrc, nSamples );
+		}
+
+		void toInt16( sf::Int16 * pDst, const float * pSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			ToInt16( pDst, pSrc, nFrames, fGain0, fGainStep, pDither );
+		}
+
+		void toInt16Stereo( sf::Int16 * pDst, const float * const * ppSrc, int nFrames, float fGain0, float fGainStep, const float * pDither )
+		{
+			ToInt16( pDst, ppSrc, 2, nFrames, fGain0, fGainStep, pDither );
+		}
+	}
+
+	static const Kernels s_ScalarKernels{ EISA::Scalar, Scalar::accumulate, Scalar::applyFade, Scalar::peakAbs, Scalar::toInt16, Scalar::toInt16Stereo, Scalar::DotProduct };
+#if LL_MIX_X86
+	static const Kernels s_SSE2Kernels{ EISA::SSE2, SSE2::Accumulate, SSE2::ApplyFade, SSE2::PeakAbs, SSE2::ToInt16, SSE2::ToInt16Stereo, SSE2::DotProduct };
+	static const Kernels s_AVX2Kernels{ EISA::AVX2, AVX2::Accumulate, AVX2::ApplyFade, AVX2::PeakAbs, AVX2::ToInt16, AVX2::ToInt16Stereo, AVX2::DotProduct };
+#endif
+
+	static const Kernels * getKernels( EISA eISA )
+	{
+		switch ( eISA )
+		{
+#if LL_MIX_X86
+			case EISA::AVX2:
+				return &s_AVX2Kernels;
+			case EISA::SSE2:
+				return &s_SSE2Kernels;
+#endif
+			default:
+				return &s_ScalarKernels;
+		}
+	}
+
+	// Resolved on first use, can be changed via SetISA
+	static std::atomic<const Kernels *> s_pKernels( nullptr );
+
+	static const Kernels * activeKernels()
+	{
+		const Kernels * pKernels = s_pKernels.load( std::memory_order_relaxed );
+		if ( pKernels == nullptr )
+		{
+			pKernels = getKernels( GetBestISA() );
+			s_pKernels.store( pKernels, std::memory_order_relaxed );
+		}
+
+		return pKernels;
+	}
+
+	EISA GetBestISA()
+	{
+#if LL_MIX_X86 && (defined( __GNUC__ ) || defined( __clang__ ))
+		__builtin_cpu_init();
+		if ( __builtin_cpu_supports( "avx2" ) )
+			return EISA::AVX2;
+		if ( __builtin_cpu_supports( "sse2" ) )
+			return EISA::SSE2;
+#elif LL_MIX_X86 && defined( _MSC_VER )
+		int anInfo[4];
+		__cpuid( anInfo, 0 );
+		const int nMaxLeaf = anInfo[0];
+
+		__cpuid( anInfo, 1 );
+		const bool bSSE2 = (anInfo[3] & (1 << 26)) != 0;
+
+		// AVX2 needs the OS to save the YMM registers too
+		const bool bOSXSave = (anInfo[2] & (1 << 27)) != 0;
+		const bool bAVX = (anInfo[2] & (1 << 28)) != 0;
+		if ( nMaxLeaf >= 7 && bOSXSave && bAVX && (_xgetbv( 0 ) & 6) == 6 )
+		{
+			__cpuidex( anInfo, 7, 0 );
+			if ( anInfo[1] & (1 << 5) )
+				return EISA::AVX2;
+		}
+
+		if ( bSSE2 )
+			return EISA::SSE2;
+#endif
+		return EISA::Scalar;
+	}
+
+	EISA GetISA()
+	{
+		return activeKernels()->eISA;
+	}
+
+	bool SetISA( EISA eISA )
+	{
+		if ( (int) eISA > (int) GetBestISA() )
+			return false;
+
+		s_pKernels.store( getKernels( eISA ) );
+		return true;
+	}
+
+	const char * GetISAName( EISA eISA )
+	{
+		switch ( eISA )
+		{
+			case EISA::AVX2:
+				return "AVX2";
+			case EISA::SSE2:
+				return "SSE2";
+			default:
+				return "Scalar";
+		}
+	}
+
+	void Accumulate( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep )
+	{
+		if ( nFrames > 0 )
+			activeKernels()->pfnAccumulate( pDst, pSrc, nFrames, fGain0, fGainStep );
+	}
+
+	void ApplyFade( float * pDst, const sf::Int16 * pSrc, int nFrames, float fGain0, float fGainStep, const float * pCurve )
+	{
+		if ( nFrames > 0 )
+			activeKernels()->pfnApplyFade( pDst, pSrc, nFrames, fGain0, fGainStep, pCurve );
+	}
+
+	float PeakAbs( const float * pSrc, int nSamples )
+	{
+		if ( nSamples <= 0 )
+			return 0.f;
+
+		return activeKernels()->pfnPeakAbs( pSrc, nSamples );
+	}
+
+	void ToInt16( sf::Int16 * pDst, const float * const * ppSrc, int nChannels, int nFrames, float fGain0, float fGainStep, const float * pDither )
+	{
+		if ( nFrames <= 0 || nChannels <= 0 )
+			return;
+
+		// Mono doesn't need interleaving at all
+		if ( nChannels == 1 )
+			activeKernels()->pfnToInt16( pDst, ppSrc[0], nFrames, fGain0, fGainStep, pDither );
+		else if ( nChannels == 2 )
+			activeKernels()->pfnToInt16Stereo( pDst, ppSrc, nFrames, fGain0, fGainStep, pDither );
+		else
+			Scalar::ToInt16( pDst, ppSrc, nChannels, nFrames, fGain0, fGainStep, pDither );
+	}
+
+	float DotProduct( const float * pA, const float * pB, int nSamples )
+	{
+		if ( nSamples <= 0 )
+			return 0.f;
+
+		return activeKernels()->pfnDotProduct( pA, pB, nSamples );
+	}
+}
@@ -0,0 +1,80 @@
+#include "NullSink.h"
+
+#include <chrono>
+
+NullSink::NullSink( bool bClocked ) :
+	m_bClocked( bClocked ),
+	m_pSource( nullptr ),
+	m_nChannels( 0 ),
+	m_nSampleRate( 0 ),
+	m_bRunning( false ),
+	m_nFrames( 0 )
+{
+}
+
+NullSink::~NullSink()
+{
+	Stop();
+}
+
+bool NullSink::Start( Source * pSource, int nChannels, int nSampleRate )
+{
+	if ( pSource == nullptr || nChannels <= 0 || nSampleRate <= 0 )
+		return false;
+
+	// Not whatever a derived sink does on Stop, just our thread
+	NullSink::Stop();
+	m_pSource = pSource;
+	m_nChannels = nChannels;
+	m_nSampleRate = nSampleRate;
+	m_bRunning.store( true );
+	m_Thread = std::thread( &NullSink::run, this );
+
+	return true;
+}
+
+void NullSink::Stop()
+{
+	m_bRunning.store( false );
+	if ( m_Thread.joinable() )
+		m_Thread.join();
+}
+
+bool NullSink::IsPlaying() const
+{
+	return m_bRunning.load();
+}
+
+sf::Int64 NullSink::GetFrameCount() const
+{
+	return m_nFrames.load();
+}
+
+void NullSink::onBlock( const Chunk& )
+{
+}
+
+// Clocked sinks keep to a schedule worked out from the first block,
+// rather than sleeping a block's length each time, so they don't drift
+void NullSink::run()
+{
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point tStart = Clock::now();
+	sf::Int64 nFrames = 0;
+
+	while ( m_bRunning.load() )
+	{
+		Chunk chunk;
+		if ( m_pSource->onGetData( chunk ) == false )
+			break;
+
+		onBlock( chunk );
+		nFrames += (sf::Int64) chunk.nSamples / m_nChannels;
+		m_nFrames.fetch_add( (sf::Int64) chunk.nSamples / m_nChannels );
+
+		if ( m_bClocked )
+			std::this_thread::sleep_until( tStart + std::chrono::microseconds( nFrames * 1000000 / m_nSampleRate ) );
+	}
+
+	m_bRunning.store( false );
+}
@@ -0,0 +1,21 @@
+#include "OutputSink.h"
+
+OutputSink::OutputSink() :
+	m_fVolume( 100.f )
+{
+}
+
+void OutputSink::Pause()
+{
+	Stop();
+}
+
+void OutputSink::SetVolume( float fVolume )
+{
+	m_fVolume = fVolume;
+}
+
+float OutputSink::GetVolume() const
+{
+	return m_fVolume;
+}
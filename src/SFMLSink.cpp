@@ -0,0 +1,72 @@
+#include "SFMLSink.h"
+
+SFMLSink::SFMLSink() :
+	m_pSource( nullptr )
+{
+}
+
+// SFML's thread has to be done with us before we go
+SFMLSink::~SFMLSink()
+{
+	stop();
+}
+
+bool SFMLSink::Start( Source * pSource, int nChannels, int nSampleRate )
+{
+	if ( pSource == nullptr || nChannels <= 0 || nSampleRate <= 0 )
+		return false;
+
+	// Initializing stops the stream, so only do it if the
+	// format changed; otherwise a paused stream resumes
+	if ( pSource != m_pSource || getChannelCount() != (unsigned int) nChannels || getSampleRate() != (unsigned int) nSampleRate )
+	{
+		stop();
+		m_pSource = pSource;
+		initialize( nChannels, nSampleRate );
+	}
+
+	play();
+	return true;
+}
+
+void SFMLSink::Stop()
+{
+	stop();
+}
+
+void SFMLSink::Pause()
+{
+	pause();
+}
+
+bool SFMLSink::IsPlaying() const
+{
+	return getStatus() == sf::SoundStream::Playing;
+}
+
+void SFMLSink::SetVolume( float fVolume )
+{
+	setVolume( fVolume );
+}
+
+float SFMLSink::GetVolume() const
+{
+	return getVolume();
+}
+
+// Called on SFML's thread
+bool SFMLSink::onGetData( sf::SoundStream::Chunk& c )
+{
+	OutputSink::Chunk chunk;
+	if ( m_pSource->onGetData( chunk ) == false )
+		return false;
+
+	c.samples = chunk.pSamples;
+	c.sampleCount = chunk.nSamples;
+	return true;
+}
+
+// The launcher's stream doesn't have a position to seek to
+void SFMLSink::onSeek( sf::Time )
+{
+}
@@ -0,0 +1,205 @@
+#include "TempoCache.h"
+#include "ClipCache.h"
+#include "ClipStretch.h"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace TempoCache
+{
+	// Bump this whenever ClipStretch changes what it makes,
+	// so files made by the old version don't get used
+	static const int s_nVersion = 1;
+
+	static std::string defaultDirectory()
+	{
+#ifdef _WIN32
+		const char * szTemp = std::getenv( "TEMP" );
+		return std::string( szTemp ? szTemp : "." ) + "\\pylLoopLauncher_tempo";
+#else
+		const char * szTemp = std::getenv( "TMPDIR" );
+		return std::string( szTemp ? szTemp : "/tmp" ) + "/pylLoopLauncher_tempo";
+#endif
+	}
+
+	// The directory and busy list are guarded by s_muCache. There's a
+	// mutex for every file being made, which whoever's making it holds
+	// until it's in place; entries are weak, and get swept as we go
+	static std::mutex s_muCache;
+	static std::string s_strDirectory = defaultDirectory();
+	static std::map<std::string, std::weak_ptr<std::mutex>> s_mapBusy;
+	static std::atomic<int> s_nHits( 0 );
+	static std::atomic<int> s_nMisses( 0 );
+	static std::atomic<int> s_nTempFiles( 0 );
+
+	static bool makeDirectory( const std::string& dirName )
+	{
+#ifdef _WIN32
+		return _mkdir( dirName.c_str() ) == 0 || errno == EEXIST;
+#else
+		return mkdir( dirName.c_str(), 0755 ) == 0 || errno == EEXIST;
+#endif
+	}
+
+	static bool fileExists( const std::string& fileName )
+	{
+		std::ifstream file( fileName, std::ios::binary );
+		return file.good();
+	}
+
+	// SFML picks the format from the extension, so the
+	// file is only finished once it's been destroyed
+	static bool writeClip( const ClipBuffer& buffer, const std::string& fileName )
+	{
+		sf::OutputSoundFile file;
+		if ( file.openFromFile( fileName, buffer.GetSampleRate(), buffer.GetChannelCount() ) == false )
+			return false;
+
+		const int nChunkFrames = 16384;
+		std::vector<sf::Int16> vChunk( size_t( nChunkFrames ) * buffer.GetChannelCount() );
+		for ( int nFrame = 0; nFrame < buffer.GetFrameCount(); nFrame += nChunkFrames )
+		{
+			const int nCount = std::min( nChunkFrames, buffer.GetFrameCount() - nFrame );
+			buffer.Interleave( vChunk.data(), nFrame, nCount );
+			file.write( vChunk.data(), sf::Uint64( nCount ) * buffer.GetChannelCount() );
+		}
+
+		return true;
+	}
+
+	sf::Uint64 HashFile( std::string fileName )
+	{
+		std::ifstream file( fileName, std::ios::binary );
+		if ( file.good() == false )
+			return 0;
+
+		sf::Uint64 uHash = 14695981039346656037ull;
+		std::vector<char> vChunk( 1 << 16 );
+		while ( file.read( vChunk.data(), vChunk.size() ) || file.gcount() > 0 )
+		{
+			const std::streamsize nRead = file.gcount();
+			for ( std::streamsize i = 0; i < nRead; i++ )
+				uHash = (uHash ^ (unsigned char) vChunk[i]) * 1099511628211ull;
+		}
+
+		return uHash;
+	}
+
+	std::string Acquire( std::string fileName, float fSrcBPM, float fDstBPM )
+	{
+		const std::string strDirectory = GetDirectory();
+		if ( strDirectory.empty() || fSrcBPM <= 0.f || fDstBPM <= 0.f )
+			return "";
+
+		const sf::Uint64 uHash = HashFile( fileName );
+		if ( uHash == 0 )
+			return "";
+
+		// Tempos go in the name in thousandths of a BPM
+		char szName[128];
+		std::snprintf( szName, sizeof( szName ), "v%d_%016llx_%ld_%ld", s_nVersion, (unsigned long long) uHash, std::lround( fSrcBPM * 1000.f ), std::lround( fDstBPM * 1000.f ) );
+#ifdef _WIN32
+		const std::string strBase = strDirectory + "\\" + szName;
+#else
+		const std::string strBase = strDirectory + "/" + szName;
+#endif
+		const std::string strPath = strBase + ".wav";
+
+		// If someone else is making this one, wait for them
+		std::shared_ptr<std::mutex> pBusy;
+		{
+			std::lock_guard<std::mutex> lg( s_muCache );
+			for ( auto it = s_mapBusy.begin(); it != s_mapBusy.end(); )
+				it = it->second.expired() ? s_mapBusy.erase( it ) : std::next( it );
+
+			pBusy = s_mapBusy[strPath].lock();
+			if ( pBusy == nullptr )
+			{
+				pBusy = std::make_shared<std::mutex>();
+				s_mapBusy[strPath] = pBusy;
+			}
+		}
+		std::lock_guard<std::mutex> lgBusy( *pBusy );
+
+		if ( fileExists( strPath ) )
+		{
+			s_nHits++;
+			return strPath;
+		}
+
+		std::shared_ptr<const ClipBuffer> pSrc = ClipCache::Acquire( fileName );
+		if ( pSrc == nullptr )
+			return "";
+
+		ClipBuffer stretched;
+		if ( ClipStretch::Stretch( *pSrc, stretched, ClipStretch::GetStretchedFrameCount( pSrc->GetFrameCount(), fSrcBPM, fDstBPM ) ) == false )
+			return "";
+
+		// Other processes could be writing the same file, so the temporary
+		// name has our process ID in it; it keeps the extension for SFML
+#ifdef _WIN32
+		const int nProcess = _getpid();
+#else
+		const int nProcess = (int) getpid();
+#endif
+		const std::string strTemp = strBase + ".tmp" + std::to_string( nProcess ) + "_" + std::to_string( s_nTempFiles++ ) + ".wav";
+		if ( makeDirectory( strDirectory ) == false || writeClip( stretched, strTemp ) == false )
+		{
+			std::remove( strTemp.c_str() );
+			return "";
+		}
+
+		// Renaming over a file fails on some platforms, but
+		// then someone else has already put it in place
+		if ( std::rename( strTemp.c_str(), strPath.c_str() ) != 0 )
+		{
+			std::remove( strTemp.c_str() );
+			if ( fileExists( strPath ) == false )
+				return "";
+		}
+
+		s_nMisses++;
+		return strPath;
+	}
+
+	void SetDirectory( std::string dirName )
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		s_strDirectory = dirName;
+	}
+
+	std::string GetDirectory()
+	{
+		std::lock_guard<std::mutex> lg( s_muCache );
+		return s_strDirectory;
+	}
+
+	int GetHitCount()
+	{
+		return s_nHits.load();
+	}
+
+	int GetMissCount()
+	{
+		return s_nMisses.load();
+	}
+}
@@ -0,0 +1,101 @@
+#include "Timeline.h"
+
+#include <algorithm>
+#include <limits>
+
+Timeline::Timeline() :
+	m_nCapacity( 0 ),
+	m_nEvents( 0 ),
+	m_nDropped( 0 )
+{
+}
+
+Timeline::Timeline( Timeline&& other ) :
+	m_vEvents( std::move( other.m_vEvents ) ),
+	m_nCapacity( other.m_nCapacity ),
+	m_nEvents( other.m_nEvents.load() ),
+	m_nDropped( other.m_nDropped.load() )
+{
+}
+
+Timeline& Timeline::operator=( Timeline&& other )
+{
+	m_vEvents = std::move( other.m_vEvents );
+	m_nCapacity = other.m_nCapacity;
+	m_nEvents.store( other.m_nEvents.load() );
+	m_nDropped.store( other.m_nDropped.load() );
+
+	return *this;
+}
+
+// The vector never grows past what's reserved here, so
+// inserting into it on the audio thread doesn't allocate
+void Timeline::Reserve( int nEvents )
+{
+	m_nCapacity = std::max( 0, nEvents );
+	m_vEvents.clear();
+	m_vEvents.reserve( m_nCapacity );
+	m_nEvents.store( 0 );
+	m_nDropped.store( 0 );
+}
+
+int Timeline::GetCapacity() const
+{
+	return m_nCapacity;
+}
+
+int Timeline::GetEventCount() const
+{
+	return m_nEvents.load( std::memory_order_relaxed );
+}
+
+int Timeline::GetDroppedCount() const
+{
+	return m_nDropped.load( std::memory_order_relaxed );
+}
+
+bool Timeline::Insert( const Event& event )
+{
+	if ( (int) m_vEvents.size() >= m_nCapacity )
+	{
+		m_nDropped.fetch_add( 1, std::memory_order_relaxed );
+		return false;
+	}
+
+	// Going in front of any events on the same frame means
+	// they come off the back before this one does
+	auto itPos = std::lower_bound( m_vEvents.begin(), m_vEvents.end(), event.nFrame, [] ( const Event& other, sf::Int64 nFrame )
+	{
+		return other.nFrame > nFrame;
+	} );
+	m_vEvents.insert( itPos, event );
+	m_nEvents.store( (int) m_vEvents.size(), std::memory_order_relaxed );
+
+	return true;
+}
+
+sf::Int64 Timeline::GetNextFrame() const
+{
+	if ( m_vEvents.empty() )
+		return std::numeric_limits<sf::Int64>::max();
+
+	return m_vEvents.back().nFrame;
+}
+
+bool Timeline::Pop( sf::Int64 nFrame, Event& event )
+{
+	if ( m_vEvents.empty() || m_vEvents.back().nFrame > nFrame )
+		return false;
+
+	event = m_vEvents.back();
+	m_vEvents.pop_back();
+	m_nEvents.store( (int) m_vEvents.size(), std::memory_order_relaxed );
+
+	return true;
+}
+
+void Timeline::Clear()
+{
+	m_vEvents.clear();
+	m_nEvents.store( 0 );
+}
@@ -0,0 +1,142 @@
+#include "VoicePool.h"
+
+#include <algorithm>
+
+VoicePool::VoicePool() :
+	m_nActive( 0 ),
+	m_nStolen( 0 )
+{
+}
+
+VoicePool::VoicePool( VoicePool&& other ) :
+	m_vVoices( std::move( other.m_vVoices ) ),
+	m_vCurve( std::move( other.m_vCurve ) ),
+	m_nActive( other.m_nActive.load() ),
+	m_nStolen( other.m_nStolen.load() )
+{
+}
+
+VoicePool& VoicePool::operator=( VoicePool&& other )
+{
+	m_vVoices = std::move( other.m_vVoices );
+	m_vCurve = std::move( other.m_vCurve );
+	m_nActive.store( other.m_nActive.load() );
+	m_nStolen.store( other.m_nStolen.load() );
+
+	return *this;
+}
+
+void VoicePool::Reserve( int nVoices, int nBlockSize )
+{
+	m_vVoices.resize( std::max( 0, nVoices ) );
+	m_vCurve.resize( std::max( 0, nBlockSize ) );
+	Clear();
+	m_nStolen.store( 0 );
+}
+
+int VoicePool::GetCapacity() const
+{
+	return (int) m_vVoices.size();
+}
+
+int VoicePool::GetActiveCount() const
+{
+	return m_nActive.load( std::memory_order_relaxed );
+}
+
+int VoicePool::GetStolenCount() const
+{
+	return m_nStolen.load( std::memory_order_relaxed );
+}
+
+// Find a free voice, or steal the one with the least left to play
+VoicePool::Voice& VoicePool::acquire()
+{
+	Voice * pVictim = &m_vVoices.front();
+	for ( auto& voice : m_vVoices )
+	{
+		if ( voice.nTrack < 0 )
+		{
+			m_nActive.fetch_add( 1, std::memory_order_relaxed );
+			return voice;
+		}
+
+		if ( voice.nFramesLeft < pVictim->nFramesLeft )
+			pVictim = &voice;
+	}
+
+	m_nStolen.fetch_add( 1, std::memory_order_relaxed );
+	return *pVictim;
+}
+
+void VoicePool::StartTail( int nTrack, int nClip, int nCursor, int nDelay, int nFadeFrames, FadeCurves::EShape eShape )
+{
+	if ( m_vVoices.empty() || nFadeFrames <= 0 )
+		return;
+
+	Voice& voice = acquire();
+	voice.nTrack = nTrack;
+	voice.nClip = nClip;
+	voice.nCursor = nCursor;
+	voice.nDelay = nDelay;
+	voice.nFramesLeft = nFadeFrames;
+	voice.nFadeFrames = nFadeFrames;
+	voice.eShape = eShape;
+	voice.fGain = 1.f;
+}
+
+void VoicePool::StartOneShot( int nTrack, int nClip, int nFrames, float fGain )
+{
+	if ( m_vVoices.empty() || nFrames <= 0 )
+		return;
+
+	Voice& voice = acquire();
+	voice.nTrack = nTrack;
+	voice.nClip = nClip;
+	voice.nCursor = 0;
+	voice.nDelay = 0;
+	voice.nFramesLeft = nFrames;
+	voice.nFadeFrames = 0;
+	voice.eShape = FadeCurves::EShape::Linear;
+	voice.fGain = fGain;
+}
+
+void VoicePool::StopTrack( int nTrack )
+{
+	for ( auto& voice : m_vVoices )
+		if ( voice.nTrack == nTrack )
+			Release( voice );
+}
+
+void VoicePool::StopClip( int nTrack, int nClip )
+{
+	for ( auto& voice : m_vVoices )
+		if ( voice.nTrack == nTrack && voice.nClip == nClip )
+			Release( voice );
+}
+
+void VoicePool::Clear()
+{
+	for ( auto& voice : m_vVoices )
+		voice.nTrack = -1;
+	m_nActive.store( 0 );
+}
+
+std::vector<VoicePool::Voice>& VoicePool::GetVoices()
+{
+	return m_vVoices;
+}
+
+void VoicePool::Release( Voice& voice )
+{
+	if ( voice.nTrack < 0 )
+		return;
+
+	voice.nTrack = -1;
+	m_nActive.fetch_sub( 1, std::memory_order_relaxed );
+}
+
+float * VoicePool::GetCurve()
+{
+	return m_vCurve.data();
+}
@@ -29,8 +29,9 @@ int main( int argc, char ** argv )
 		// Call the update function with a pointer to the loop launcher
 		driverScript.call_function( "Update", &ll ).convert( loop );
 
-		// Sleep 10 milliseconds
-		sf::sleep( sf::milliseconds( 10 ) );
+		// Sleep until the next boundary, when there's work to do; the
+		// timeout is just so the script still sees key presses promptly
+		ll.WaitForBoundary( 50 );
 	}
 
 	return 0;
@@ -0,0 +1,155 @@
+#include "LoopLauncher.h"
+#include "AllocTrap.h"
+#include "NullSink.h"
+
+#include <SFML/Audio/OutputSoundFile.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+// AllocTrapTest
+// Plays a set through a free running NullSink with the allocation trap
+// built in (see AllocTrap), doing everything the control thread can do
+// to the audio thread while it runs: switching clips with tails (so
+// voices), one-shots, a streamed clip, compressed clips, scheduled
+// clips on the timeline, and adding and removing tracks and clips (so
+// table swaps.) Then it does an offline Render. Fails if the audio
+// thread went to the heap at any point.
+
+namespace
+{
+	const int s_nSampleRate = 44100;
+
+	// A tone of the given length, written to a WAV file next to us
+	std::string writeTone( std::string name, double dFreq, float fSeconds )
+	{
+		const std::string fileName = "AllocTrapTest_" + name + ".wav";
+		const int nFrames = (int) (fSeconds * s_nSampleRate);
+
+		sf::OutputSoundFile file;
+		if ( file.openFromFile( fileName, s_nSampleRate, 2 ) == false )
+			return "";
+
+		std::vector<sf::Int16> vSamples( 2 * 4096 );
+		for ( int nFrame = 0; nFrame < nFrames; nFrame += 4096 )
+		{
+			const int nCount = std::min( 4096, nFrames - nFrame );
+			for ( int i = 0; i < nCount; i++ )
+				vSamples[2 * i] = vSamples[2 * i + 1] = (sf::Int16) (8000. * std::sin( 6.283185307179586 * dFreq * (nFrame + i) / s_nSampleRate ));
+			file.write( vSamples.data(), 2 * nCount );
+		}
+
+		return fileName;
+	}
+
+	int s_nFailures = 0;
+
+	void check( bool bOK, const char * szWhat )
+	{
+		if ( bOK )
+			return;
+
+		std::fprintf( stderr, "failed: %s\n", szWhat );
+		s_nFailures++;
+	}
+}
+
+int main()
+{
+	if ( AllocTrap::IsEnabled() == false )
+	{
+		std::fprintf( stderr, "the allocation trap isn't built in\n" );
+		return 1;
+	}
+
+	// Count traps rather than aborting, so we can say where they
+	// happened; first make sure the trap actually springs
+	AllocTrap::SetAbort( false );
+	{
+		AllocTrap::Scope allocTrap;
+		std::unique_ptr<int> pInt( new int( 0 ) );
+	}
+	check( AllocTrap::GetTrapCount() == 2, "the trap doesn't catch new and delete" );
+	const int nSelfTestTraps = AllocTrap::GetTrapCount();
+
+	const std::string strA1 = writeTone( "a1", 220., 1.f );
+	const std::string strA2 = writeTone( "a2", 330., 1.f );
+	const std::string strShot = writeTone( "shot", 880., 0.25f );
+	const std::string strLong = writeTone( "long", 110., Clip::s_fStreamSeconds + 1.f );
+	const std::string strC1 = writeTone( "c1", 440., 0.5f );
+	const std::string strC2 = writeTone( "c2", 550., 0.5f );
+	check( strA1.size() && strA2.size() && strShot.size() && strLong.size() && strC1.size() && strC2.size(), "couldn't write the clips" );
+
+	LoopLauncher launcher;
+	launcher.SetOutputSink( std::unique_ptr<OutputSink>( new NullSink( false ) ) );
+	check( launcher.Initialize( { { "a", { strA1, strA2, strShot } }, { "long", { strLong } } }, 256 ), "Initialize" );
+	launcher.SetLaunchGrid( LoopLauncher::ELaunchQuantum::Beat, 480.f, 4 );
+	launcher.SetTrackTail( "a", 200.f );
+	launcher.SetTrackFade( "a", 20.f, FadeCurves::EShape::Linear );
+
+	// Clips loaded from here on are kept compressed
+	launcher.SetClipCompression( true, 2 );
+
+	launcher.UpdatePendingClips( { strA1, strLong } );
+	launcher.Play();
+
+	for ( int nStep = 0; nStep < 64; nStep++ )
+	{
+		launcher.WaitForBoundary( 100 );
+
+		// Switching leaves a tail playing on a voice
+		launcher.UpdatePendingClips( { nStep % 2 ? strA1 : strA2, strLong } );
+		launcher.TriggerClip( strShot, 0.5f );
+		launcher.SetTrackGain( "a", 0.5f + 0.5f * (nStep % 2) );
+		launcher.SetTrackPan( "a", nStep % 3 - 1.f );
+
+		// Scheduled a little way ahead, so it goes on the timeline
+		const sf::Int64 nFrame = launcher.GetPlayFrame() + 2048;
+		switch ( nStep % 8 )
+		{
+			case 0:
+				check( launcher.AddTrack( "c", std::list<std::string>{ strC1 } ) >= 0, "AddTrack" );
+				break;
+			case 2:
+				check( launcher.AddClip( "c", strC2 ) >= 0, "AddClip" );
+				break;
+			case 3:
+				launcher.ScheduleClips( nFrame, { strC1 } );
+				break;
+			case 4:
+				launcher.ScheduleClips( nFrame, { strC2, strA2 } );
+				break;
+			case 5:
+				launcher.ClearSchedule();
+				launcher.ScheduleClipsOnGrid( launcher.GetNextGridLine() + 1, { strC1 } );
+				break;
+			case 6:
+				check( launcher.RemoveClip( strC2 ), "RemoveClip" );
+				break;
+			case 7:
+				check( launcher.RemoveTrack( "c" ), "RemoveTrack" );
+				break;
+		}
+	}
+
+	launcher.Stop();
+	const sf::Int64 nPlayed = launcher.GetPlayFrame();
+	check( nPlayed > 0, "nothing got played" );
+
+	// Then offline, with the same tracks
+	check( launcher.AddTrack( "c", std::list<std::string>{ strC1, strC2 } ) >= 0, "AddTrack before Render" );
+	check( launcher.Render( "AllocTrapTest_render.wav", 4 * s_nSampleRate, {
+		{ 0, { strA1, strLong, strC1 } },
+		{ s_nSampleRate, { strA2, strC2 } },
+		{ 2 * s_nSampleRate, { strA1 } } } ), "Render" );
+
+	const int nTraps = AllocTrap::GetTrapCount() - nSelfTestTraps;
+	check( nTraps == 0, "the audio thread allocated" );
+
+	std::printf( "%lld frames played, %d allocation(s) on the audio thread\n", (long long) nPlayed, nTraps );
+	return s_nFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include "MixKernels.h"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// MixKernelsTest
+// Checks that every instruction set this machine supports gives bit
+// for bit the same output as the scalar path, for every kernel. Inputs
+// are random, gains ramp up and down, lengths aren't multiples of the
+// vector width, and every buffer is offset a few elements from where
+// it was allocated so the vector paths see unaligned heads and tails.
+// Returns nonzero if anything differs.
+
+namespace
+{
+	// Lengths around the vector widths, plus a couple of long ones
+	const std::vector<int> s_vLengths = { 0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33, 63, 100, 257, 1023, 1025 };
+
+	// How far into each buffer we start, in elements
+	const std::vector<int> s_vOffsets = { 0, 1, 2, 3, 5 };
+
+	std::mt19937 s_Random( 1234 );
+
+	std::vector<sf::Int16> randomSamples( int nCount )
+	{
+		std::uniform_int_distribution<int> dist( -32768, 32767 );
+		std::vector<sf::Int16> v( nCount );
+		for ( auto& s : v )
+			s = (sf::Int16) dist( s_Random );
+		return v;
+	}
+
+	std::vector<float> randomFloats( int nCount, float fMin, float fMax )
+	{
+		std::uniform_real_distribution<float> dist( fMin, fMax );
+		std::vector<float> v( nCount );
+		for ( auto& f : v )
+			f = dist( s_Random );
+		return v;
+	}
+
+	float randomFloat( float fMin, float fMax )
+	{
+		return std::uniform_real_distribution<float>( fMin, fMax )( s_Random );
+	}
+
+	// A gain ramp from somewhere to somewhere else over nFrames
+	void randomRamp( int nFrames, float& fGain0, float& fGainStep )
+	{
+		fGain0 = randomFloat( 0.f, 2.f );
+		fGainStep = nFrames > 0 ? (randomFloat( 0.f, 2.f ) - fGain0) / nFrames : 0.f;
+	}
+
+	bool sameBits( const void * pA, const void * pB, size_t nBytes )
+	{
+		return nBytes == 0 || std::memcmp( pA, pB, nBytes ) == 0;
+	}
+
+	// Runs fnKernel under the scalar path and then under eISA,
+	// and compares the bytes of output it hands back
+	template <typename Fn>
+	bool matchesScalar( MixKernels::EISA eISA, Fn fnKernel )
+	{
+		MixKernels::SetISA( MixKernels::EISA::Scalar );
+		const std::vector<unsigned char> vScalar = fnKernel();
+		MixKernels::SetISA( eISA );
+		const std::vector<unsigned char> vISA = fnKernel();
+		return vScalar.size() == vISA.size() && sameBits( vScalar.data(), vISA.data(), vScalar.size() );
+	}
+
+	template <typename T>
+	std::vector<unsigned char> toBytes( const T * pData, int nCount )
+	{
+		const unsigned char * pBytes = (const unsigned char *) pData;
+		return std::vector<unsigned char>( pBytes, pBytes + nCount * sizeof( T ) );
+	}
+
+	int s_nFailures = 0;
+
+	void check( bool bMatch, const char * szKernel, MixKernels::EISA eISA, int nFrames, int nOffset )
+	{
+		if ( bMatch )
+			return;
+
+		std::fprintf( stderr, "%s under %s differs from scalar (%d frames, offset %d)\n", szKernel, MixKernels::GetISAName( eISA ), nFrames, nOffset );
+		s_nFailures++;
+	}
+
+	void testAccumulate( MixKernels::EISA eISA, int nFrames, int nOffset )
+	{
+		const std::vector<sf::Int16> vSrc = randomSamples( nFrames + nOffset );
+		const std::vector<float> vDst = randomFloats( nFrames + nOffset, -1.f, 1.f );
+		float fGain0, fGainStep;
+		randomRamp( nFrames, fGain0, fGainStep );
+
+		// Scaled down like the mixer's gains, so the sums stay small
+		fGain0 /= 32768.f;
+		fGainStep /= 32768.f;
+
+		check( matchesScalar( eISA, [&] ()
+		{
+			std::vector<float> vOut = vDst;
+			MixKernels::Accumulate( vOut.data() + nOffset, vSrc.data() + nOffset, nFrames, fGain0, fGainStep );
+			return toBytes( vOut.data(), (int) vOut.size() );
+		} ), "Accumulate", eISA, nFrames, nOffset );
+	}
+
+	void testApplyFade( MixKernels::EISA eISA, int nFrames, int nOffset )
+	{
+		const std::vector<sf::Int16> vSrc = randomSamples( nFrames + nOffset );
+		const std::vector<float> vCurve = randomFloats( nFrames + nOffset, 0.f, 1.f );
+		const std::vector<float> vDst = randomFloats( nFrames + nOffset, -1.f, 1.f );
+		float fGain0, fGainStep;
+		randomRamp( nFrames, fGain0, fGainStep );
+		fGain0 /= 32768.f;
+		fGainStep /= 32768.f;
+
+		check( matchesScalar( eISA, [&] ()
+		{
+			std::vector<float> vMix = vDst;
+			MixKernels::ApplyFade( vMix.data() + nOffset, vSrc.data() + nOffset, nFrames, fGain0, fGainStep, vCurve.data() + nOffset );
+			return toBytes( vMix.data(), (int) vMix.size() );
+		} ), "ApplyFade", eISA, nFrames, nOffset );
+	}
+
+	void testPeakAbs( MixKernels::EISA eISA, int nFrames, int nOffset )
+	{
+		// Put the peak somewhere random, negative half the time
+		std::vector<float> vSrc = randomFloats( nFrames + nOffset, -1.f, 1.f );
+		if ( nFrames > 0 )
+			vSrc[nOffset + s_Random() % nFrames] = (s_Random() & 1) ? 1.5f : -1.5f;
+
+		check( matchesScalar( eISA, [&] ()
+		{
+			const float fPeak = MixKernels::PeakAbs( vSrc.data() + nOffset, nFrames );
+			return toBytes( &fPeak, 1 );
+		} ), "PeakAbs", eISA, nFrames, nOffset );
+	}
+
+	void testToInt16( MixKernels::EISA eISA, int nFrames, int nOffset, int nChannels )
+	{
+		// Past full scale, so saturation gets tested too
+		std::vector<std::vector<float>> vvSrc;
+		std::vector<const float *> vpSrc;
+		for ( int c = 0; c < nChannels; c++ )
+			vvSrc.push_back( randomFloats( nFrames + nOffset, -1.2f, 1.2f ) );
+		for ( auto& vSrc : vvSrc )
+			vpSrc.push_back( vSrc.data() + nOffset );
+
+		const std::vector<float> vDither = randomFloats( nFrames * nChannels + nOffset, -1.f, 1.f );
+		float fGain0, fGainStep;
+		randomRamp( nFrames, fGain0, fGainStep );
+
+		check( matchesScalar( eISA, [&] ()
+		{
+			std::vector<sf::Int16> vOut( nFrames * nChannels + nOffset, 0 );
+			MixKernels::ToInt16( vOut.data() + nOffset, vpSrc.data(), nChannels, nFrames, fGain0, fGainStep, vDither.data() + nOffset );
+			return toBytes( vOut.data(), (int) vOut.size() );
+		} ), nChannels == 1 ? "ToInt16 (mono)" : nChannels == 2 ? "ToInt16 (stereo)" : "ToInt16", eISA, nFrames, nOffset );
+	}
+
+	void testDotProduct( MixKernels::EISA eISA, int nSamples, int nOffset )
+	{
+		const std::vector<float> vA = randomFloats( nSamples + nOffset, -1.f, 1.f );
+		const std::vector<float> vB = randomFloats( nSamples + nOffset, -1.f, 1.f );
+
+		check( matchesScalar( eISA, [&] ()
+		{
+			const float fDot = MixKernels::DotProduct( vA.data() + nOffset, vB.data() + nOffset, nSamples );
+			return toBytes( &fDot, 1 );
+		} ), "DotProduct", eISA, nSamples, nOffset );
+	}
+}
+
+int main()
+{
+	int nISAs = 0;
+	for ( int i = (int) MixKernels::EISA::SSE2; i <= (int) MixKernels::EISA::AVX2; i++ )
+	{
+		const MixKernels::EISA eISA = (MixKernels::EISA) i;
+		if ( MixKernels::SetISA( eISA ) == false )
+		{
+			std::printf( "%s isn't supported here, skipping it\n", MixKernels::GetISAName( eISA ) );
+			continue;
+		}
+
+		for ( int nFrames : s_vLengths )
+		{
+			for ( int nOffset : s_vOffsets )
+			{
+				testAccumulate( eISA, nFrames, nOffset );
+				testApplyFade( eISA, nFrames, nOffset );
+				testPeakAbs( eISA, nFrames, nOffset );
+				for ( int nChannels = 1; nChannels <= 3; nChannels++ )
+					testToInt16( eISA, nFrames, nOffset, nChannels );
+
+				// DotProduct only takes multiples of 8
+				testDotProduct( eISA, nFrames & ~7, nOffset );
+			}
+		}
+
+		nISAs++;
+	}
+
+	std::printf( "%d instruction set(s) checked against scalar, %d mismatch(es)\n", nISAs, s_nFailures );
+	return s_nFailures == 0 ? 0 : 1;
+}